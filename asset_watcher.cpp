@@ -0,0 +1,153 @@
+#include "asset_watcher.h"
+
+#include "log.h"
+
+#include <chrono>
+#include <map>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// editors often write a file in several chunks, wait for it to settle before reloading
+constexpr auto k_settle_time = std::chrono::milliseconds(150);
+constexpr int k_poll_interval_ms = 100;
+
+bool AssetWatcher::Start(const std::filesystem::path& directory, ChangeCallback on_change)
+{
+    Stop();
+
+    std::error_code error;
+    if(!std::filesystem::is_directory(directory, error))
+    {
+        LogWarning("Asset watcher: %s is not a directory", directory.string().c_str());
+        return false;
+    }
+
+    m_directory = directory;
+    m_on_change = std::move(on_change);
+    m_stop_requested = false;
+
+#ifdef __linux__
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_inotify_fd < 0 || inotify_add_watch(m_inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        LogWarning("Asset watcher: inotify unavailable, falling back to polling");
+        if(m_inotify_fd >= 0)
+        {
+            close(m_inotify_fd);
+        }
+
+        m_inotify_fd = -1;
+    }
+#endif
+
+    m_thread = std::thread(&AssetWatcher::Run, this);
+    Log("Watching %s for asset changes", directory.string().c_str());
+    return true;
+}
+
+void AssetWatcher::Stop()
+{
+    if(!m_thread.joinable())
+    {
+        return;
+    }
+
+    m_stop_requested = true;
+    m_thread.join();
+
+#ifdef __linux__
+    if(m_inotify_fd >= 0)
+    {
+        close(m_inotify_fd);
+    }
+#endif
+
+    m_inotify_fd = -1;
+}
+
+void AssetWatcher::Run()
+{
+    std::map<std::filesystem::path, Clock::time_point> pending;
+    std::map<std::filesystem::path, std::filesystem::file_time_type> last_write_times;
+
+    const auto ScanLastWriteTimes = [&](const bool report_changes){
+        std::error_code error;
+        for(const auto& entry : std::filesystem::directory_iterator(m_directory, error))
+        {
+            if(!entry.is_regular_file(error))
+            {
+                continue;
+            }
+
+            const auto write_time = entry.last_write_time(error);
+            auto [it, inserted] = last_write_times.try_emplace(entry.path(), write_time);
+            if(!inserted && it->second != write_time)
+            {
+                it->second = write_time;
+                if(report_changes)
+                {
+                    pending[entry.path()] = Clock::now();
+                }
+            }
+        }
+    };
+
+    if(m_inotify_fd < 0)
+    {
+        ScanLastWriteTimes(false);
+    }
+
+    while(!m_stop_requested)
+    {
+#ifdef __linux__
+        if(m_inotify_fd >= 0)
+        {
+            pollfd fd{m_inotify_fd, POLLIN, 0};
+            if(poll(&fd, 1, k_poll_interval_ms) > 0)
+            {
+                alignas(inotify_event) char buffer[4096];
+                ssize_t length;
+                while((length = read(m_inotify_fd, buffer, sizeof(buffer))) > 0)
+                {
+                    for(char* p = buffer; p < buffer + length; )
+                    {
+                        const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                        if(event->len > 0)
+                        {
+                            pending[m_directory / event->name] = Clock::now();
+                        }
+
+                        p += sizeof(inotify_event) + event->len;
+                    }
+                }
+            }
+        }
+        else
+#endif
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(k_poll_interval_ms));
+            ScanLastWriteTimes(true);
+        }
+
+        const auto now = Clock::now();
+        for(auto it = pending.begin(); it != pending.end(); )
+        {
+            if(now - it->second < k_settle_time)
+            {
+                ++it;
+                continue;
+            }
+
+            Log("Asset changed: %s", it->first.string().c_str());
+            m_on_change(it->first);
+            it = pending.erase(it);
+        }
+    }
+}
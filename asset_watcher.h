@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+// Watches a directory for files that finished being written and reports them
+// from a background thread. Uses inotify on Linux and falls back to polling
+// modification times everywhere else.
+class AssetWatcher
+{
+public:
+    using ChangeCallback = std::function<void(const std::filesystem::path&)>;
+
+    AssetWatcher() = default;
+    AssetWatcher(const AssetWatcher&) = delete;
+    AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+    ~AssetWatcher()
+    {
+        Stop();
+    }
+
+    // on_change runs on the watcher thread, so it is the place to do slow work like parsing
+    bool Start(const std::filesystem::path& directory, ChangeCallback on_change);
+    void Stop();
+
+    bool is_running() const { return m_thread.joinable(); }
+
+private:
+    void Run();
+
+    std::filesystem::path m_directory;
+    ChangeCallback m_on_change;
+    std::thread m_thread;
+    std::atomic<bool> m_stop_requested = false;
+    int m_inotify_fd = -1;
+};
@@ -0,0 +1,484 @@
+#include "counters.h"
+#include "golden.h"
+#include "log.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchSettings
+{
+    std::filesystem::path mesh_path = "assets/Suzanne.obj";
+    std::filesystem::path sprite_atlas_path = "assets/WallpaperAtlas.png";
+    std::string report_path;
+    std::string trace_path;
+    std::string hashes_path;
+    std::filesystem::path golden_directory;
+    glm::ivec2 screen_size{800, 600};
+    // a cell of the wallpaper grid, or else a rectangle in texels, or else the whole atlas
+    glm::ivec2 atlas_cell{-1, -1};
+    Rectangle atlas_rectangle{};
+    int frame_count = 600;
+    int warmup_frame_count = 30;
+    int thread_count = 1;
+    int trace_frame_count = 10;
+    int golden_tolerance = 1;
+    bool update_golden = false;
+};
+
+struct FrameSample
+{
+    double milliseconds;
+    // counted by the bench itself, with or without DEMO3D_COUNTERS
+    int64_t triangles;
+    int64_t covered_pixels;
+    int64_t counters[k_counter_count];
+    int64_t stage_nanoseconds[k_profile_stage_count];
+    FrameHashes hashes;
+};
+
+BenchSettings g_settings;
+
+void ParseCommandLine(const int argc, char** argv);
+void UpdateBenchCamera(Viewport& viewport, const int frame, const int frame_count);
+FrameSample RunFrame(Viewport& viewport, const int frame, const int frame_count);
+int64_t CountCoveredPixels(const Viewport& viewport);
+double Percentile(const std::vector<double>& sorted, const double percentile);
+std::string EscapeJsonString(const std::string& text);
+void WriteReport(std::FILE* file, const std::vector<FrameSample>& samples);
+bool WriteFrameHashes(const std::string& path, const std::vector<FrameSample>& samples);
+
+int main(int argc, char** argv)
+{
+    ParseCommandLine(argc, argv);
+
+    // the bench shares the demo's headless path, no window and no frame cap
+    g_is_headless = true;
+
+    // info logs and raylib both write to stdout, keep them quiet when the report goes there
+    const bool is_report_on_stdout = g_settings.report_path.empty() && g_settings.golden_directory.empty();
+    SetTraceLogLevel(is_report_on_stdout ? LOG_WARNING : LOG_DEBUG);
+    SetLogLevel(is_report_on_stdout ? LogLevel::Warning : LogLevel::Debug);
+    SetProfileThreadName("Main");
+    if(g_settings.thread_count > 1)
+    {
+        LogWarning("The renderer is single threaded, --threads %d only gets recorded in the report", g_settings.thread_count);
+    }
+
+    g_virtual_page_budget = GetVirtualPageBudget(g_settings.screen_size);
+    g_sprite_atlas = LoadTextureAsset(g_settings.sprite_atlas_path);
+    if(g_settings.atlas_cell.x >= 0)
+    {
+        g_atlas_region = GetAtlasCellRegion(g_sprite_atlas, k_wallpaper_atlas_grid, g_settings.atlas_cell.x, g_settings.atlas_cell.y);
+    }
+    else if(g_settings.atlas_rectangle.width > 0)
+    {
+        g_atlas_region = GetTextureRegion(g_sprite_atlas, g_settings.atlas_rectangle);
+    }
+
+    g_main_light.direction = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+    g_main_light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    g_main_light.intensity = 1.0f;
+    if(!g_settings.golden_directory.empty())
+    {
+        const int failed_count = RunGoldenImages(g_settings.golden_directory, g_settings.update_golden, g_settings.golden_tolerance);
+        return failed_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    Viewport viewport;
+    InitializeCamera(viewport, {0, 0, g_settings.screen_size.x, g_settings.screen_size.y}, 20.0f, 250.0f);
+    g_mesh = LoadMeshAsset(g_settings.mesh_path);
+
+    for(int frame = 0; frame < g_settings.warmup_frame_count; ++frame)
+    {
+        RunFrame(viewport, frame, g_settings.warmup_frame_count);
+    }
+
+    std::vector<FrameSample> samples;
+    samples.reserve(g_settings.frame_count);
+    for(int frame = 0; frame < g_settings.frame_count; ++frame)
+    {
+        samples.push_back(RunFrame(viewport, frame, g_settings.frame_count));
+    }
+
+    if(!g_settings.trace_path.empty())
+    {
+        // the last measured frames get drawn once more for the trace, recording it must not skew the report
+        const int first_traced_frame = std::max(0, g_settings.frame_count - g_settings.trace_frame_count);
+        const int traced_frame_count = g_settings.frame_count - first_traced_frame;
+        ArmTraceCapture(traced_frame_count);
+        for(int frame = first_traced_frame; frame < g_settings.frame_count; ++frame)
+        {
+            RunFrame(viewport, frame, g_settings.frame_count);
+        }
+
+        if(!WriteChromeTrace(g_settings.trace_path, traced_frame_count))
+        {
+            LogError("Failed to write trace to %s", g_settings.trace_path.c_str());
+        }
+    }
+
+    if(!g_settings.hashes_path.empty() && !WriteFrameHashes(g_settings.hashes_path, samples))
+    {
+        LogError("Failed to write frame hashes to %s", g_settings.hashes_path.c_str());
+    }
+
+    std::FILE* file = g_settings.report_path.empty() ? stdout : std::fopen(g_settings.report_path.c_str(), "w");
+    if(!file)
+    {
+        LogError("Failed to open %s", g_settings.report_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    WriteReport(file, samples);
+    if(file != stdout)
+    {
+        std::fclose(file);
+        Log("Wrote %s", g_settings.report_path.c_str());
+    }
+
+    UnloadImage(viewport.z_buffer);
+    UnloadImage(viewport.color_buffer);
+    return EXIT_SUCCESS;
+}
+
+void ParseCommandLine(const int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if(arg == "--frames" && i + 1 < argc)
+        {
+            g_settings.frame_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--warmup" && i + 1 < argc)
+        {
+            g_settings.warmup_frame_count = std::max(0, std::atoi(argv[++i]));
+        }
+        else if(arg == "--size" && i + 1 < argc)
+        {
+            int width = 0, height = 0;
+            if(std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            {
+                g_settings.screen_size = {width, height};
+            }
+        }
+        else if(arg == "--atlas-cell" && i + 1 < argc)
+        {
+            int column = 0, row = 0;
+            if(std::sscanf(argv[++i], "%d,%d", &column, &row) == 2 && column >= 0 && row >= 0)
+            {
+                g_settings.atlas_cell = {column, row};
+            }
+        }
+        else if(arg == "--atlas-rect" && i + 1 < argc)
+        {
+            int x = 0, y = 0, width = 0, height = 0;
+            if(std::sscanf(argv[++i], "%d,%d,%dx%d", &x, &y, &width, &height) == 4 && width > 0 && height > 0)
+            {
+                g_settings.atlas_rectangle = {(float)x, (float)y, (float)width, (float)height};
+            }
+        }
+        else if(arg == "--threads" && i + 1 < argc)
+        {
+            g_settings.thread_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--mesh" && i + 1 < argc)
+        {
+            g_settings.mesh_path = argv[++i];
+        }
+        else if(arg == "--report" && i + 1 < argc)
+        {
+            g_settings.report_path = argv[++i];
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            g_settings.trace_path = argv[++i];
+        }
+        else if(arg == "--trace-frames" && i + 1 < argc)
+        {
+            g_settings.trace_frame_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--hashes" && i + 1 < argc)
+        {
+            g_settings.hashes_path = argv[++i];
+        }
+        else if(arg == "--golden" && i + 1 < argc)
+        {
+            g_settings.golden_directory = argv[++i];
+        }
+        else if(arg == "--update-golden")
+        {
+            g_settings.update_golden = true;
+        }
+        else if(arg == "--golden-tolerance" && i + 1 < argc)
+        {
+            g_settings.golden_tolerance = std::clamp(std::atoi(argv[++i]), 0, 255);
+        }
+        else if(arg == "--compress-vertices")
+        {
+            g_mesh_vertex_format = VertexFormat::Compressed;
+        }
+        else if(arg == "--compress-vertices-oct8")
+        {
+            g_mesh_vertex_format = VertexFormat::CompressedOct8;
+        }
+        else if(arg == "--no-mesh-optimization")
+        {
+            g_optimize_mesh = false;
+        }
+        else if(arg == "--orthographic")
+        {
+            g_start_orthographic = true;
+        }
+        else if(arg == "--no-mipmaps")
+        {
+            g_texture_filter = TextureFilter::Nearest;
+        }
+        else if(arg == "--nearest-mip")
+        {
+            g_texture_filter = TextureFilter::NearestMip;
+        }
+        else if(arg == "--trilinear")
+        {
+            g_texture_filter = TextureFilter::Trilinear;
+        }
+        else if(arg == "--blocked-textures")
+        {
+            g_texture_layout = TextureLayout::Blocked4x4;
+        }
+        else if(arg == "--morton-textures")
+        {
+            g_texture_layout = TextureLayout::Morton;
+        }
+        else if(arg == "--bc1-textures")
+        {
+            g_texture_layout = TextureLayout::Bc1;
+        }
+        else if(arg == "--virtual-textures")
+        {
+            g_texture_layout = TextureLayout::Virtual;
+        }
+        else if(arg == "--tiled-framebuffer" && i + 1 < argc)
+        {
+            // 8 or 16 pixels square
+            g_framebuffer_layout = std::atoi(argv[++i]) == 16 ? FramebufferLayout::Tiled16x16 : FramebufferLayout::Tiled8x8;
+        }
+        else if(arg == "--affine-texture-mapping")
+        {
+            g_texture_mapping = TextureMapping::Affine;
+        }
+        else if(arg == "--exact-texture-mapping")
+        {
+            g_texture_mapping = TextureMapping::Exact;
+        }
+        else
+        {
+            LogWarning("Ignoring unknown argument %s", argv[i]);
+        }
+    }
+}
+
+void UpdateBenchCamera(Viewport& viewport, const int frame, const int frame_count)
+{
+    // one full orbit around the mesh, bobbing up and down while zooming in and out twice,
+    // driven by the frame index so every run renders exactly the same frames
+    const ftype t = (ftype)frame / (ftype)frame_count;
+    const ftype angle = glm::radians(360.0f * t);
+    const ftype distance = 15.0f;
+    const ftype height = 5.0f * glm::sin(2.0f * angle);
+
+    MyCamera& camera = viewport.camera;
+    camera.position = glm::vec3(distance * glm::sin(angle), height, distance * glm::cos(angle));
+    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+    camera.fov = 20.0f + 12.0f * glm::sin(4.0f * angle);
+    UpdateViewport(viewport, {1, 1});
+}
+
+FrameSample RunFrame(Viewport& viewport, const int frame, const int frame_count)
+{
+    constexpr ftype frame_time = 1.0f / 60.0f;
+    g_since_start = frame * frame_time;
+    g_frame_time = frame_time;
+
+    const auto start = Clock::now();
+    PROFILE_BEGIN_FRAME();
+    UpdateBenchCamera(viewport, frame, frame_count);
+    RenderWorld(viewport);
+    PROFILE_END_FRAME();
+    const auto end = Clock::now();
+    AggregateCounters();
+
+    // hashed and counted outside the timed part, it reads every byte of both buffers
+    FrameSample sample = {};
+    sample.hashes = HashFrame(viewport);
+    sample.triangles = g_mesh.triangle_count();
+    sample.covered_pixels = CountCoveredPixels(viewport);
+    for(int counter = 0; counter < k_counter_count; ++counter)
+    {
+        sample.counters[counter] = GetFrameCounter((Counter)counter);
+    }
+
+#ifdef DEMO3D_PROFILING
+    const ProfileFrame& profile = GetProfileFrame(0);
+    std::copy(std::begin(profile.stage_nanoseconds), std::end(profile.stage_nanoseconds), sample.stage_nanoseconds);
+#endif
+    sample.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    return sample;
+}
+
+int64_t CountCoveredPixels(const Viewport& viewport)
+{
+    // pixels something was drawn over, their depth moved off the far clear value
+    const Color* depths = (const Color*)viewport.z_buffer.data;
+    const int64_t pixel_count = (int64_t)viewport.z_buffer.width * viewport.z_buffer.height;
+    return std::count_if(depths, depths + pixel_count, [](const Color depth){ return depth.b != WHITE.b; });
+}
+
+double Percentile(const std::vector<double>& sorted, const double percentile)
+{
+    // nearest rank
+    const size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::string EscapeJsonString(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for(const char c : text)
+    {
+        if(c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if((unsigned char)c < 0x20)
+        {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+void WriteReport(std::FILE* file, const std::vector<FrameSample>& samples)
+{
+    std::vector<double> frame_times;
+    frame_times.reserve(samples.size());
+    double total_counters[k_counter_count] = {};
+    double total_triangles = 0.0;
+    double total_covered_pixels = 0.0;
+    double total_stage_nanoseconds[k_profile_stage_count] = {};
+    for(const FrameSample& sample : samples)
+    {
+        frame_times.push_back(sample.milliseconds);
+        total_triangles += (double)sample.triangles;
+        total_covered_pixels += (double)sample.covered_pixels;
+        for(int counter = 0; counter < k_counter_count; ++counter)
+        {
+            total_counters[counter] += sample.counters[counter];
+        }
+
+        for(int stage = 0; stage < k_profile_stage_count; ++stage)
+        {
+            total_stage_nanoseconds[stage] += sample.stage_nanoseconds[stage];
+        }
+    }
+
+    const double total_milliseconds = std::accumulate(frame_times.begin(), frame_times.end(), 0.0);
+    const double total_seconds = total_milliseconds / 1000.0;
+    std::sort(frame_times.begin(), frame_times.end());
+
+    std::fprintf(file, "{\n");
+    std::fprintf(file, "  \"mesh\": \"%s\",\n", EscapeJsonString(g_settings.mesh_path.generic_string()).c_str());
+    std::fprintf(file, "  \"width\": %d,\n", g_settings.screen_size.x);
+    std::fprintf(file, "  \"height\": %d,\n", g_settings.screen_size.y);
+    std::fprintf(file, "  \"threads\": %d,\n", g_settings.thread_count);
+    std::fprintf(file, "  \"frames\": %zu,\n", samples.size());
+    std::fprintf(file, "  \"warmup_frames\": %d,\n", g_settings.warmup_frame_count);
+    std::fprintf(file, "  \"texture_mapping\": \"%s\",\n", GetTextureMappingName(g_texture_mapping));
+    std::fprintf(file, "  \"texture_filter\": \"%s\",\n", GetTextureFilterName(g_texture_filter));
+    std::fprintf(file, "  \"texture_layout\": \"%s\",\n", GetTextureLayoutName(g_texture_layout));
+    std::fprintf(file, "  \"texture_bytes\": %zu,\n", g_sprite_atlas.memory_size());
+    std::fprintf(file, "  \"framebuffer_layout\": \"%s\",\n", GetFramebufferLayoutName(g_framebuffer_layout));
+    std::fprintf(file, "  \"atlas_region\": {\"offset\": [%.6f, %.6f], \"scale\": [%.6f, %.6f]},\n",
+        g_atlas_region.offset.x, g_atlas_region.offset.y, g_atlas_region.scale.x, g_atlas_region.scale.y);
+#ifdef DEMO3D_PROFILING
+    std::fprintf(file, "  \"stage_ms\": {\n");
+    for(int stage = 0; stage < k_profile_stage_count; ++stage)
+    {
+        const char* separator = stage + 1 < k_profile_stage_count ? "," : "";
+        const double mean_milliseconds = total_stage_nanoseconds[stage] / (1000000.0 * samples.size());
+        std::fprintf(file, "    \"%s\": %.4f%s\n", GetProfileStageName((ProfileStage)stage), mean_milliseconds, separator);
+    }
+    std::fprintf(file, "  },\n");
+#endif
+    // throughput of the whole mesh and the screen pixels it ends up covering, the counters break
+    // both down further
+    std::fprintf(file, "  \"triangles_per_second\": %.1f,\n", total_seconds > 0 ? total_triangles / total_seconds : 0.0);
+    std::fprintf(file, "  \"pixels_per_second\": %.1f,\n", total_seconds > 0 ? total_covered_pixels / total_seconds : 0.0);
+#ifdef DEMO3D_COUNTERS
+    std::fprintf(file, "  \"counters_per_frame\": {\n");
+    for(int counter = 0; counter < k_counter_count; ++counter)
+    {
+        const char* separator = counter + 1 < k_counter_count ? "," : "";
+        std::fprintf(file, "    \"%s\": %.1f%s\n", GetCounterName((Counter)counter), total_counters[counter] / samples.size(), separator);
+    }
+    std::fprintf(file, "  },\n");
+#endif
+    // the whole run in one value per buffer, equal hashes mean every frame came out bit identical
+    FrameHashes run_hashes = {14695981039346656037ull, 14695981039346656037ull};
+    for(const FrameSample& sample : samples)
+    {
+        run_hashes.color = (run_hashes.color ^ sample.hashes.color) * 1099511628211ull;
+        run_hashes.depth = (run_hashes.depth ^ sample.hashes.depth) * 1099511628211ull;
+    }
+
+    std::fprintf(file, "  \"color_hash\": \"%016llx\",\n", (unsigned long long)run_hashes.color);
+    std::fprintf(file, "  \"depth_hash\": \"%016llx\",\n", (unsigned long long)run_hashes.depth);
+    std::fprintf(file, "  \"frame_ms\": {\n");
+    std::fprintf(file, "    \"mean\": %.4f,\n", total_milliseconds / samples.size());
+    std::fprintf(file, "    \"median\": %.4f,\n", Percentile(frame_times, 50.0));
+    std::fprintf(file, "    \"p95\": %.4f,\n", Percentile(frame_times, 95.0));
+    std::fprintf(file, "    \"p99\": %.4f,\n", Percentile(frame_times, 99.0));
+    std::fprintf(file, "    \"min\": %.4f,\n", frame_times.front());
+    std::fprintf(file, "    \"max\": %.4f\n", frame_times.back());
+    std::fprintf(file, "  }\n");
+    std::fprintf(file, "}\n");
+}
+
+bool WriteFrameHashes(const std::string& path, const std::vector<FrameSample>& samples)
+{
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if(!file)
+    {
+        return false;
+    }
+
+    // one line per measured frame, diffable between runs
+    for(size_t frame = 0; frame < samples.size(); ++frame)
+    {
+        std::fprintf(file, "%zu %016llx %016llx\n", frame, (unsigned long long)samples[frame].hashes.color, (unsigned long long)samples[frame].hashes.depth);
+    }
+
+    return std::fclose(file) == 0;
+}
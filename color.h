@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "raylib.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEMO3D_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Conversions between the 8 bit RGBA the buffers and textures store and the float colors shading
+// works in. Unpacking reads a table instead of dividing every channel by 255. Packing scales all four
+// channels in one register, truncates and saturates while narrowing, which writes the same bytes as
+// ColorFromNormalized for channels within 0 to 1 and clamps the ones outside without a branch.
+
+constexpr std::array<float, 256> MakeUnorm8Table()
+{
+    std::array<float, 256> table{};
+    for(int i = 0; i < 256; ++i)
+    {
+        table[i] = i / 255.0f;
+    }
+
+    return table;
+}
+
+inline constexpr std::array<float, 256> k_unorm8_to_float = MakeUnorm8Table();
+
+inline glm::vec4 NormalizeColor(const Color color)
+{
+    return {k_unorm8_to_float[color.r], k_unorm8_to_float[color.g], k_unorm8_to_float[color.b], k_unorm8_to_float[color.a]};
+}
+
+inline Color PackColor(const glm::vec4 color)
+{
+#ifdef DEMO3D_SSE2
+    const __m128i channels = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(&color.x), _mm_set1_ps(255.0f)));
+    const __m128i words = _mm_packs_epi32(channels, channels);
+    const int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    Color packed;
+    std::memcpy(&packed, &bytes, sizeof(packed));
+    return packed;
+#else
+    const auto PackChannel = [](const float value){
+        return (unsigned char)(glm::clamp(value, 0.0f, 1.0f) * 255.0f);
+    };
+
+    return {PackChannel(color.x), PackChannel(color.y), PackChannel(color.z), PackChannel(color.w)};
+#endif
+}
+
+// rgb times the light, alpha stays the texture's
+inline glm::vec4 ModulateColor(const glm::vec4 texture_color, const glm::vec4 light_color)
+{
+#ifdef DEMO3D_SSE2
+    const __m128 light = _mm_loadu_ps(&light_color.x);
+    const __m128 light_rgb1 = _mm_or_ps(_mm_and_ps(light, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))), _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+    glm::vec4 modulated;
+    _mm_storeu_ps(&modulated.x, _mm_mul_ps(_mm_loadu_ps(&texture_color.x), light_rgb1));
+    return modulated;
+#else
+    return {texture_color.x * light_color.x, texture_color.y * light_color.y, texture_color.z * light_color.z, texture_color.w};
+#endif
+}
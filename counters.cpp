@@ -0,0 +1,67 @@
+#include "counters.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::mutex g_counter_slots_mutex;
+std::vector<std::unique_ptr<CounterSlot>> g_counter_slots;
+// slots only ever grow, the aggregate works on the difference to what it saw last frame
+// so it never has to write to a slot another thread owns
+std::vector<std::array<int64_t, k_counter_count>> g_counter_snapshots;
+int64_t g_frame_counters[k_counter_count] = {};
+
+CounterSlot& RegisterCounterSlot()
+{
+    // only taken the first time a thread counts something, slots live until the process exits
+    std::lock_guard lock{g_counter_slots_mutex};
+    g_counter_slots.push_back(std::make_unique<CounterSlot>());
+    g_counter_snapshots.push_back({});
+    t_counter_slot = g_counter_slots.back().get();
+    return *t_counter_slot;
+}
+
+void AggregateCounters()
+{
+    std::lock_guard lock{g_counter_slots_mutex};
+    for(int counter = 0; counter < k_counter_count; ++counter)
+    {
+        g_frame_counters[counter] = 0;
+    }
+
+    for(size_t slot = 0; slot < g_counter_slots.size(); ++slot)
+    {
+        for(int counter = 0; counter < k_counter_count; ++counter)
+        {
+            const int64_t value = g_counter_slots[slot]->values[counter].load(std::memory_order_relaxed);
+            g_frame_counters[counter] += value - g_counter_snapshots[slot][counter];
+            g_counter_snapshots[slot][counter] = value;
+        }
+    }
+}
+
+int64_t GetFrameCounter(const Counter counter)
+{
+    return g_frame_counters[(int)counter];
+}
+
+const char* GetCounterName(const Counter counter)
+{
+    switch(counter)
+    {
+        case Counter::TrianglesIn: return "Triangles in";
+        case Counter::TrianglesCulled: return "Triangles culled";
+        case Counter::TrianglesClipped: return "Triangles clipped";
+        case Counter::FragmentsRasterized: return "Fragments rasterized";
+        case Counter::FragmentsOutsideScreen: return "Fragments off-screen";
+        case Counter::FragmentsOccluded: return "Fragments occluded";
+        case Counter::FragmentsShaded: return "Fragments shaded";
+        case Counter::FragmentsWritten: return "Fragments written";
+        case Counter::TexelsFetched: return "Texels fetched";
+        case Counter::TextureBlocksDecoded: return "Texture blocks decoded";
+        case Counter::VirtualPagesLoaded: return "Virtual pages loaded";
+        case Counter::FramebufferTilesCleared: return "Framebuffer tiles cleared";
+        default: return "Unknown";
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Pipeline counters. Every thread adds into its own cache line sized slot, AggregateCounters sums
+// the slots into per frame totals once the frame is rendered. Build without DEMO3D_COUNTERS and
+// COUNTER_ADD expands to nothing.
+
+enum class Counter
+{
+    TrianglesIn,
+    TrianglesCulled,  // backfacing
+    TrianglesClipped, // crossing the screen or depth bounds, their fragments get rejected one by one
+    FragmentsRasterized,
+    FragmentsOutsideScreen,
+    FragmentsOccluded,
+    FragmentsShaded,
+    FragmentsWritten, // passed the depth test
+    TexelsFetched,
+    TextureBlocksDecoded, // compressed blocks that missed the decoded block cache
+    VirtualPagesLoaded,
+    FramebufferTilesCleared, // tiles a frame wrote or left stale, the rest needed no clear
+    Count
+};
+
+constexpr int k_counter_count = (int)Counter::Count;
+constexpr size_t k_cache_line_size = 64;
+
+struct alignas(k_cache_line_size) CounterSlot
+{
+    std::atomic<int64_t> values[k_counter_count] = {};
+};
+
+// constant initialized and defined in the header so the hot path reads it without a TLS wrapper call
+inline thread_local CounterSlot* t_counter_slot = nullptr;
+
+CounterSlot& RegisterCounterSlot();
+void AggregateCounters();
+// totals of the last aggregated frame
+int64_t GetFrameCounter(const Counter counter);
+const char* GetCounterName(const Counter counter);
+
+inline void AddCounter(const Counter counter, const int64_t amount)
+{
+    CounterSlot& slot = t_counter_slot ? *t_counter_slot : RegisterCounterSlot();
+    std::atomic<int64_t>& value = slot.values[(int)counter];
+    // only the owning thread writes its slot, so a relaxed load and store is enough and compiles to a plain add
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+#ifdef DEMO3D_COUNTERS
+#define COUNTER_ADD(counter, amount) AddCounter(counter, amount)
+#else
+#define COUNTER_ADD(counter, amount)
+#endif
@@ -0,0 +1,251 @@
+#include "framebuffer.h"
+
+#include "color.h"
+#include "counters.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+FramebufferLayout g_framebuffer_layout = FramebufferLayout::Linear;
+
+// the tiles of a linear framebuffer only track clears, a row of one is a 64 byte cache line
+constexpr int k_linear_clear_tile_shift = 4;
+
+const char* GetFramebufferLayoutName(const FramebufferLayout layout)
+{
+    switch(layout)
+    {
+        case FramebufferLayout::Linear: return "Linear";
+        case FramebufferLayout::Tiled8x8: return "Tiled 8x8";
+        case FramebufferLayout::Tiled16x16: return "Tiled 16x16";
+        default: return "Unknown";
+    }
+}
+
+static bool IsSameColor(const Color a, const Color b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+void InitializeFramebuffer(Framebuffer& framebuffer, const Image& color_image, const Image& depth_image, const FramebufferLayout layout)
+{
+    framebuffer.layout = layout;
+    framebuffer.width = color_image.width;
+    framebuffer.height = color_image.height;
+    framebuffer.tile_shift = layout == FramebufferLayout::Tiled8x8 ? 3 : layout == FramebufferLayout::Tiled16x16 ? 4 : k_linear_clear_tile_shift;
+    framebuffer.color_image = (Color*)color_image.data;
+    framebuffer.depth_image = (Color*)depth_image.data;
+    framebuffer.clear_color = BLACK;
+    framebuffer.clear_depth = WHITE;
+
+    const int tile_size = 1 << framebuffer.tile_shift;
+    framebuffer.tiles_x = (framebuffer.width + tile_size - 1) / tile_size;
+    framebuffer.tiles_y = (framebuffer.height + tile_size - 1) / tile_size;
+    const size_t tile_count = (size_t)framebuffer.tiles_x * framebuffer.tiles_y;
+    framebuffer.tile_states.assign(tile_count, TileState::Cleared);
+    if(layout == FramebufferLayout::Linear)
+    {
+        framebuffer.tiled_color = {};
+        framebuffer.tiled_depth = {};
+        return;
+    }
+
+    framebuffer.tiled_color.assign(tile_count * tile_size * tile_size, framebuffer.clear_color);
+    framebuffer.tiled_depth.assign(tile_count * tile_size * tile_size, framebuffer.clear_depth);
+}
+
+void ClearFramebuffer(Framebuffer& framebuffer, const Color color, const Color depth)
+{
+    // a new clear value makes even the cleared tiles stale
+    const bool is_new_clear = !IsSameColor(color, framebuffer.clear_color) || !IsSameColor(depth, framebuffer.clear_depth);
+    framebuffer.clear_color = color;
+    framebuffer.clear_depth = depth;
+    for(TileState& state : framebuffer.tile_states)
+    {
+        state = is_new_clear || state == TileState::Drawn ? TileState::Stale : state;
+    }
+}
+
+static void ClearTile(Framebuffer& framebuffer, const size_t tile)
+{
+    COUNTER_ADD(Counter::FramebufferTilesCleared, 1);
+    const int tile_size = 1 << framebuffer.tile_shift;
+    if(framebuffer.layout != FramebufferLayout::Linear)
+    {
+        const size_t first = tile * tile_size * tile_size;
+        std::fill_n(framebuffer.tiled_color.begin() + first, tile_size * tile_size, framebuffer.clear_color);
+        std::fill_n(framebuffer.tiled_depth.begin() + first, tile_size * tile_size, framebuffer.clear_depth);
+        return;
+    }
+
+    // tiles on the right and bottom edge stop at the edge of the images
+    const int x = (int)(tile % framebuffer.tiles_x) * tile_size;
+    const int y = (int)(tile / framebuffer.tiles_x) * tile_size;
+    const int width = std::min(tile_size, framebuffer.width - x);
+    const int y_end = std::min(y + tile_size, framebuffer.height);
+    for(int row = y; row < y_end; ++row)
+    {
+        const size_t offset = (size_t)row * framebuffer.width + x;
+        std::fill_n(framebuffer.color_image + offset, width, framebuffer.clear_color);
+        std::fill_n(framebuffer.depth_image + offset, width, framebuffer.clear_depth);
+    }
+}
+
+void BeginTile(Framebuffer& framebuffer, const size_t tile)
+{
+    if(framebuffer.tile_states[tile] == TileState::Stale)
+    {
+        ClearTile(framebuffer, tile);
+    }
+
+    framebuffer.tile_states[tile] = TileState::Drawn;
+}
+
+// one row of a tile, 8 or 16 pixels, 2 or 4 registers
+static inline void CopyTileRow(const Color* tile_row, Color* row, const int tile_size)
+{
+#ifdef DEMO3D_SSE2
+    for(int x = 0; x < tile_size; x += 4)
+    {
+        _mm_storeu_si128((__m128i*)(row + x), _mm_loadu_si128((const __m128i*)(tile_row + x)));
+    }
+#else
+    std::copy(tile_row, tile_row + tile_size, row);
+#endif
+}
+
+static inline void FillTileRow(const Color color, Color* row, const int tile_size)
+{
+#ifdef DEMO3D_SSE2
+    int packed;
+    std::memcpy(&packed, &color, sizeof(packed));
+    const __m128i colors = _mm_set1_epi32(packed);
+    for(int x = 0; x < tile_size; x += 4)
+    {
+        _mm_storeu_si128((__m128i*)(row + x), colors);
+    }
+#else
+    std::fill_n(row, tile_size, color);
+#endif
+}
+
+static void DetilePixels(const Framebuffer& framebuffer, const Color* tiles, const Color clear_value, Color* pixels)
+{
+    // walks the image row by row so the writes stay sequential, every row reads one row of each
+    // tile drawn this frame and fills in the clear value for the others, stale or not
+    const int shift = framebuffer.tile_shift;
+    const int tile_size = 1 << shift;
+    const int mask = tile_size - 1;
+    const size_t tile_pixel_count = (size_t)tile_size * tile_size;
+    for(int y = 0; y < framebuffer.height; ++y)
+    {
+        const size_t first_tile = (size_t)(y >> shift) * framebuffer.tiles_x;
+        const Color* tile_row = tiles + first_tile * tile_pixel_count + (size_t)(y & mask) * tile_size;
+        const TileState* states = framebuffer.tile_states.data() + first_tile;
+        Color* row = pixels + (size_t)y * framebuffer.width;
+        int x = 0;
+        for(; x + tile_size <= framebuffer.width; x += tile_size, tile_row += tile_pixel_count, ++states)
+        {
+            if(*states == TileState::Drawn)
+            {
+                CopyTileRow(tile_row, row + x, tile_size);
+            }
+            else
+            {
+                FillTileRow(clear_value, row + x, tile_size);
+            }
+        }
+
+        // the last tile hangs over the right edge of the screen
+        if(x == framebuffer.width)
+        {
+            continue;
+        }
+
+        if(*states == TileState::Drawn)
+        {
+            std::copy(tile_row, tile_row + (framebuffer.width - x), row + x);
+        }
+        else
+        {
+            std::fill(row + x, row + framebuffer.width, clear_value);
+        }
+    }
+}
+
+void ResolveFramebuffer(Framebuffer& framebuffer)
+{
+    if(framebuffer.layout != FramebufferLayout::Linear)
+    {
+        // the tiles themselves stay stale until something draws into them
+        DetilePixels(framebuffer, framebuffer.tiled_color.data(), framebuffer.clear_color, framebuffer.color_image);
+        DetilePixels(framebuffer, framebuffer.tiled_depth.data(), framebuffer.clear_depth, framebuffer.depth_image);
+        return;
+    }
+
+    // the images are the tiles, whatever nothing drew over this frame gets cleared now
+    for(size_t tile = 0; tile < framebuffer.tile_states.size(); ++tile)
+    {
+        if(framebuffer.tile_states[tile] == TileState::Stale)
+        {
+            ClearTile(framebuffer, tile);
+            framebuffer.tile_states[tile] = TileState::Cleared;
+        }
+    }
+}
+
+void InvalidateFramebuffer(Framebuffer& framebuffer)
+{
+    std::fill(framebuffer.tile_states.begin(), framebuffer.tile_states.end(), TileState::Stale);
+}
+
+void DrawFramebufferLine(Framebuffer& framebuffer, const Vector2 start, const Vector2 end, const Color color)
+{
+    // Bresenham along the longer axis, u, stepping v whenever the error turns positive. Always drawn
+    // from the lower u to the higher one, like raylib does
+    Color* pixels = GetColorPixels(framebuffer);
+    const auto DrawLinePixel = [&](const int x, const int y){
+        if(x >= 0 && x < framebuffer.width && y >= 0 && y < framebuffer.height)
+        {
+            TouchTile(framebuffer, x, y);
+            pixels[GetPixelOffset(framebuffer, x, y)] = color;
+        }
+    };
+
+    int start_x = (int)start.x;
+    int start_y = (int)start.y;
+    int end_x = (int)end.x;
+    int end_y = (int)end.y;
+    const bool is_x_major = std::abs(end_y - start_y) < std::abs(end_x - start_x);
+    if(is_x_major ? end_x < start_x : end_y < start_y)
+    {
+        std::swap(start_x, end_x);
+        std::swap(start_y, end_y);
+    }
+
+    const int change_u = is_x_major ? end_x - start_x : end_y - start_y;
+    const int change_v = is_x_major ? end_y - start_y : end_x - start_x;
+    const int step_v = change_v < 0 ? -1 : 1;
+    const int a = 2 * std::abs(change_v);
+    const int b = a - 2 * change_u;
+    int p = a - change_u;
+    int u = is_x_major ? start_x : start_y;
+    int v = is_x_major ? start_y : start_x;
+    const int end_u = u + change_u;
+    is_x_major ? DrawLinePixel(u, v) : DrawLinePixel(v, u);
+    for(++u; u <= end_u; ++u)
+    {
+        if(p >= 0)
+        {
+            v += step_v;
+            p += b;
+        }
+        else
+        {
+            p += a;
+        }
+
+        is_x_major ? DrawLinePixel(u, v) : DrawLinePixel(v, u);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cstddef>
+#include <vector>
+
+// Where the rasterizer writes color and depth. A linear framebuffer writes straight into the row major
+// images of the viewport. A tiled one keeps every 8x8 or 16x16 block of pixels contiguous, so the rows
+// a triangle covers inside a block share cache lines and pages instead of sitting a screen width apart,
+// and ResolveFramebuffer detiles it into the images once the frame is drawn, before they get uploaded,
+// exported or hashed. The images are the RGBA8 ones GenImageColor makes.
+// Clears are lazy and per tile, linear framebuffers track 16x16 tiles of the images. Clearing only
+// marks what earlier frames drew as stale, the first pixel drawn into a stale tile clears it and the
+// resolve clears the stale tiles nothing drew into, so clearing costs what was covered instead of
+// the whole screen.
+
+enum class FramebufferLayout
+{
+    Linear,
+    Tiled8x8,
+    Tiled16x16,
+};
+
+enum class TileState : unsigned char
+{
+    Cleared, // holds the clear color and depth
+    Stale,   // holds pixels of an earlier frame
+    Drawn,   // cleared and drawn into this frame
+};
+
+// layout of the buffers created from now on
+extern FramebufferLayout g_framebuffer_layout;
+
+struct Framebuffer
+{
+    FramebufferLayout layout = FramebufferLayout::Linear;
+    int width = 0;
+    int height = 0;
+    int tile_shift = 0; // log2 of the tile size
+    int tiles_x = 0;
+    int tiles_y = 0;
+    // pixels of the viewport's images, not owned
+    Color* color_image = nullptr;
+    Color* depth_image = nullptr;
+    // whole tiles, the ones on the right and bottom edge hang over the screen
+    std::vector<Color> tiled_color;
+    std::vector<Color> tiled_depth;
+    std::vector<TileState> tile_states;
+    Color clear_color = BLACK;
+    Color clear_depth = WHITE;
+};
+
+const char* GetFramebufferLayoutName(const FramebufferLayout layout);
+
+// takes the images as they are, GenImageColor filled with the default clear values
+void InitializeFramebuffer(Framebuffer& framebuffer, const Image& color_image, const Image& depth_image, const FramebufferLayout layout);
+// lazy, only marks tiles as stale
+void ClearFramebuffer(Framebuffer& framebuffer, const Color color, const Color depth);
+// clears a tile that is about to be drawn into
+void BeginTile(Framebuffer& framebuffer, const size_t tile);
+// copies tiled pixels into the images and clears the tiles the frame left stale
+void ResolveFramebuffer(Framebuffer& framebuffer);
+// for whoever writes into the images after the resolve, the next frame clears all of them again
+void InvalidateFramebuffer(Framebuffer& framebuffer);
+// the same pixels as raylib's ImageDrawLineV, only the color gets written
+void DrawFramebufferLine(Framebuffer& framebuffer, const Vector2 start, const Vector2 end, const Color color);
+
+inline Color* GetColorPixels(Framebuffer& framebuffer)
+{
+    return framebuffer.layout != FramebufferLayout::Linear ? framebuffer.tiled_color.data() : framebuffer.color_image;
+}
+
+inline Color* GetDepthPixels(Framebuffer& framebuffer)
+{
+    return framebuffer.layout != FramebufferLayout::Linear ? framebuffer.tiled_depth.data() : framebuffer.depth_image;
+}
+
+// has to come before reading or writing a pixel of the tile, x and y have to be on the screen
+inline void TouchTile(Framebuffer& framebuffer, const int x, const int y)
+{
+    const size_t tile = (size_t)(y >> framebuffer.tile_shift) * framebuffer.tiles_x + (x >> framebuffer.tile_shift);
+    if(framebuffer.tile_states[tile] != TileState::Drawn)
+    {
+        BeginTile(framebuffer, tile);
+    }
+}
+
+// index of the pixel in the color and depth pixels, x and y have to be on the screen
+inline size_t GetPixelOffset(const Framebuffer& framebuffer, const int x, const int y)
+{
+    if(framebuffer.layout == FramebufferLayout::Linear)
+    {
+        return (size_t)y * framebuffer.width + x;
+    }
+
+    const int shift = framebuffer.tile_shift;
+    const int mask = (1 << shift) - 1;
+    const size_t tile = (size_t)(y >> shift) * framebuffer.tiles_x + (x >> shift);
+    return (tile << (2 * shift)) + (size_t)(((y & mask) << shift) + (x & mask));
+}
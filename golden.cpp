@@ -0,0 +1,150 @@
+#include "golden.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+constexpr glm::ivec2 k_golden_size{320, 240};
+
+// every mode that has its own path through the rasterizer, on a curved and a flat mesh
+constexpr GoldenView k_golden_views[] = {
+    {"suzanne_perspective", "assets/Suzanne.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"suzanne_orthographic", "assets/Suzanne.obj", true, false, false, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"suzanne_depth", "assets/Suzanne.obj", false, true, false, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"suzanne_wireframe", "assets/Suzanne.obj", false, false, true, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"suzanne_affine", "assets/Suzanne.obj", false, false, false, TextureMapping::Affine, TextureFilter::NearestMip},
+    {"suzanne_exact", "assets/Suzanne.obj", false, false, false, TextureMapping::Exact, TextureFilter::NearestMip},
+    {"suzanne_no_mipmaps", "assets/Suzanne.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Nearest},
+    {"suzanne_bilinear", "assets/Suzanne.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Bilinear},
+    {"suzanne_trilinear", "assets/Suzanne.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Trilinear},
+    {"suzanne_atlas_cell", "assets/Suzanne.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Trilinear, 3, 5},
+    {"suzanne_tiled", "assets/Suzanne.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Bilinear, -1, -1, FramebufferLayout::Tiled8x8},
+    {"cube_perspective", "assets/Cube.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"cube_orthographic", "assets/Cube.obj", true, false, false, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"cube_depth", "assets/Cube.obj", false, true, false, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"cube_wireframe", "assets/Cube.obj", false, false, true, TextureMapping::Subdivided, TextureFilter::NearestMip},
+    {"cube_affine", "assets/Cube.obj", false, false, false, TextureMapping::Affine, TextureFilter::NearestMip},
+    {"cube_exact", "assets/Cube.obj", false, false, false, TextureMapping::Exact, TextureFilter::NearestMip},
+    {"cube_no_mipmaps", "assets/Cube.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Nearest},
+    {"cube_bilinear", "assets/Cube.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Bilinear},
+    {"cube_trilinear", "assets/Cube.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::Trilinear},
+    {"cube_atlas_cell", "assets/Cube.obj", false, false, false, TextureMapping::Subdivided, TextureFilter::NearestMip, 3, 5},
+    {"cube_wireframe_tiled", "assets/Cube.obj", false, false, true, TextureMapping::Subdivided, TextureFilter::NearestMip, -1, -1, FramebufferLayout::Tiled16x16},
+};
+
+ImageDifference CompareImages(const Image& a, const Image& b, const int tolerance)
+{
+    if(a.width != b.width || a.height != b.height)
+    {
+        return {(int64_t)std::max(a.width * a.height, b.width * b.height), 255};
+    }
+
+    ImageDifference difference = {};
+    const Color* a_pixels = (const Color*)a.data;
+    const Color* b_pixels = (const Color*)b.data;
+    for(int i = 0; i < a.width * a.height; ++i)
+    {
+        const int pixel_difference = std::max({
+            std::abs(a_pixels[i].r - b_pixels[i].r),
+            std::abs(a_pixels[i].g - b_pixels[i].g),
+            std::abs(a_pixels[i].b - b_pixels[i].b)});
+        difference.max_channel_difference = std::max(difference.max_channel_difference, pixel_difference);
+        difference.differing_pixels += pixel_difference > tolerance ? 1 : 0;
+    }
+
+    return difference;
+}
+
+int RunGoldenImages(const std::filesystem::path& directory, const bool update, const int tolerance)
+{
+    const bool was_orthographic = g_start_orthographic;
+    const bool was_rendering_depth_buffer = g_is_rending_depth_buffer;
+    const bool was_drawing_triangle_edges = g_draw_triangle_edges;
+    const TextureMapping previous_texture_mapping = g_texture_mapping;
+    const TextureFilter previous_texture_filter = g_texture_filter;
+    const TextureRegion previous_atlas_region = g_atlas_region;
+    const FramebufferLayout previous_framebuffer_layout = g_framebuffer_layout;
+    if(update)
+    {
+        std::filesystem::create_directories(directory);
+    }
+
+    int failed_count = 0;
+    for(const GoldenView& view : k_golden_views)
+    {
+        g_start_orthographic = view.is_orthographic;
+        g_is_rending_depth_buffer = view.is_depth_view;
+        g_draw_triangle_edges = view.is_wireframe;
+        g_texture_mapping = view.texture_mapping;
+        g_texture_filter = view.texture_filter;
+        g_atlas_region = view.atlas_column < 0 ? TextureRegion{}
+            : GetAtlasCellRegion(g_sprite_atlas, k_wallpaper_atlas_grid, view.atlas_column, view.atlas_row);
+        g_framebuffer_layout = view.framebuffer_layout;
+        g_mesh = LoadMeshAsset(view.mesh_path);
+
+        // looking down at the mesh from the side so no face lines up with the screen
+        Viewport viewport{};
+        InitializeCamera(viewport, {0, 0, k_golden_size.x, k_golden_size.y}, 20.0f, 0.0f);
+        viewport.camera.position = glm::vec3(6.0f, 4.0f, 13.0f);
+        UpdateViewport(viewport, {1, 1});
+        RenderWorld(viewport);
+
+        const FrameHashes hashes = HashFrame(viewport);
+        const Image& frame = view.is_depth_view ? viewport.z_buffer : viewport.color_buffer;
+        const std::string path = (directory / (std::string(view.name) + ".ppm")).string();
+        if(update)
+        {
+            if(!ExportFrame(frame, path))
+            {
+                LogError("Failed to write golden image %s", path.c_str());
+                ++failed_count;
+            }
+            else
+            {
+                Log("Updated %s, color %016llx depth %016llx", path.c_str(), hashes.color, hashes.depth);
+            }
+        }
+        else
+        {
+            Image golden = ImportFrame(path);
+            const ImageDifference difference = IsImageReady(golden) ? CompareImages(frame, golden, tolerance) : ImageDifference{-1, 0};
+            if(difference.differing_pixels < 0)
+            {
+                LogError("%s: missing golden image %s", view.name, path.c_str());
+                ++failed_count;
+            }
+            else if(difference.differing_pixels > 0)
+            {
+                // kept next to the golden image to diff them
+                const std::string actual_path = (directory / (std::string(view.name) + ".actual.ppm")).string();
+                ExportFrame(frame, actual_path);
+                LogError("%s: %lld pixels differ by more than %d, up to %d, wrote %s",
+                    view.name, (long long)difference.differing_pixels, tolerance, difference.max_channel_difference, actual_path.c_str());
+                ++failed_count;
+            }
+            else
+            {
+                Log("%s: ok, color %016llx depth %016llx", view.name, hashes.color, hashes.depth);
+            }
+
+            if(IsImageReady(golden))
+            {
+                UnloadImage(golden);
+            }
+        }
+
+        UnloadImage(viewport.z_buffer);
+        UnloadImage(viewport.color_buffer);
+    }
+
+    g_start_orthographic = was_orthographic;
+    g_is_rending_depth_buffer = was_rendering_depth_buffer;
+    g_draw_triangle_edges = was_drawing_triangle_edges;
+    g_texture_mapping = previous_texture_mapping;
+    g_texture_filter = previous_texture_filter;
+    g_atlas_region = previous_atlas_region;
+    g_framebuffer_layout = previous_framebuffer_layout;
+    return failed_count;
+}
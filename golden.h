@@ -0,0 +1,36 @@
+#pragma once
+
+#include "renderer.h"
+
+#include <cstdint>
+#include <filesystem>
+
+// Golden image checks. A fixed set of views is rendered headless and compared against .ppm images
+// kept in a directory, updating rewrites the images instead. A view passes when no channel of any
+// pixel differs from its golden image by more than the tolerance.
+
+struct GoldenView
+{
+    const char* name;
+    const char* mesh_path;
+    bool is_orthographic;
+    bool is_depth_view;
+    bool is_wireframe;
+    TextureMapping texture_mapping;
+    TextureFilter texture_filter;
+    // a cell of k_wallpaper_atlas_grid, the whole atlas when negative
+    int atlas_column = -1;
+    int atlas_row = -1;
+    FramebufferLayout framebuffer_layout = FramebufferLayout::Linear;
+};
+
+struct ImageDifference
+{
+    int64_t differing_pixels;
+    int max_channel_difference;
+};
+
+// compares rgb only, .ppm frames have no alpha. Images of different sizes differ everywhere
+ImageDifference CompareImages(const Image& a, const Image& b, const int tolerance);
+// returns how many views failed or had no golden image
+int RunGoldenImages(const std::filesystem::path& directory, const bool update, const int tolerance);
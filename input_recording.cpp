@@ -0,0 +1,105 @@
+#include "input_recording.h"
+
+#include "log.h"
+
+#include <cstring>
+
+struct InputRecordingHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+constexpr char k_input_recording_magic[4] = {'D', '3', 'I', 'R'};
+constexpr uint32_t k_input_recording_version = 1;
+
+bool InputRecorder::Start(const std::filesystem::path& path)
+{
+    Stop();
+
+    m_file = std::fopen(path.string().c_str(), "wb");
+    if(!m_file)
+    {
+        LogError("Failed to open %s for recording input", path.string().c_str());
+        return false;
+    }
+
+    InputRecordingHeader header;
+    std::memcpy(header.magic, k_input_recording_magic, sizeof(header.magic));
+    header.version = k_input_recording_version;
+    header.record_size = sizeof(FrameInput);
+    std::fwrite(&header, sizeof(header), 1, m_file);
+    m_frame_count = 0;
+    Log("Recording input to %s", path.string().c_str());
+    return true;
+}
+
+void InputRecorder::Record(const FrameInput& input)
+{
+    if(!m_file)
+    {
+        return;
+    }
+
+    std::fwrite(&input, sizeof(input), 1, m_file);
+    ++m_frame_count;
+}
+
+void InputRecorder::Stop()
+{
+    if(!m_file)
+    {
+        return;
+    }
+
+    std::fclose(m_file);
+    m_file = nullptr;
+    Log("Recorded %d frames of input", m_frame_count);
+}
+
+bool InputReplay::Load(const std::filesystem::path& path)
+{
+    m_frames.clear();
+    m_next_frame = 0;
+
+    std::FILE* file = std::fopen(path.string().c_str(), "rb");
+    if(!file)
+    {
+        LogError("Failed to open input recording %s", path.string().c_str());
+        return false;
+    }
+
+    InputRecordingHeader header;
+    const bool is_valid_header = std::fread(&header, sizeof(header), 1, file) == 1
+        && std::memcmp(header.magic, k_input_recording_magic, sizeof(header.magic)) == 0
+        && header.version == k_input_recording_version
+        && header.record_size == sizeof(FrameInput);
+    if(!is_valid_header)
+    {
+        LogError("%s is not an input recording this build can replay", path.string().c_str());
+        std::fclose(file);
+        return false;
+    }
+
+    FrameInput input;
+    while(std::fread(&input, sizeof(input), 1, file) == 1)
+    {
+        m_frames.push_back(input);
+    }
+
+    std::fclose(file);
+    Log("Replaying %d frames of input from %s", frame_count(), path.string().c_str());
+    return is_loaded();
+}
+
+bool InputReplay::Next(FrameInput& input)
+{
+    if(is_finished())
+    {
+        return false;
+    }
+
+    input = m_frames[m_next_frame++];
+    return true;
+}
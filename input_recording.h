@@ -0,0 +1,77 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+constexpr uint32_t k_toggle_depth_view = 1 << 0;
+constexpr uint32_t k_toggle_wireframe = 1 << 1;
+constexpr uint32_t k_toggle_metrics = 1 << 2;
+constexpr uint32_t k_toggle_projection = 1 << 3;
+constexpr uint32_t k_toggle_overdraw_view = 1 << 4;
+constexpr uint32_t k_toggle_write_trace = 1 << 5;
+constexpr uint32_t k_toggle_texture_mapping = 1 << 6;
+constexpr uint32_t k_toggle_texture_filter = 1 << 7;
+
+// Everything Update consumes for one frame. The UI values are absolute, they are whatever the
+// sliders and color picker held when the frame started.
+struct FrameInput
+{
+    float frame_time;
+    float zoom;
+    glm::vec2 camera_move;
+    glm::vec2 light_move;
+    glm::vec2 screen_resize_factor;
+    float near_plane;
+    float far_plane;
+    glm::vec3 light_color;
+    float wall_x;
+    float wall_y;
+    uint32_t toggles;
+};
+
+// written to disk as is, one fixed size record per frame after a small header
+static_assert(sizeof(FrameInput) == 64);
+
+class InputRecorder
+{
+public:
+    InputRecorder() = default;
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    ~InputRecorder()
+    {
+        Stop();
+    }
+
+    bool Start(const std::filesystem::path& path);
+    void Record(const FrameInput& input);
+    void Stop();
+
+    bool is_recording() const { return m_file != nullptr; }
+
+private:
+    std::FILE* m_file = nullptr;
+    int m_frame_count = 0;
+};
+
+class InputReplay
+{
+public:
+    bool Load(const std::filesystem::path& path);
+    // false once every recorded frame has been handed out
+    bool Next(FrameInput& input);
+
+    bool is_loaded() const { return !m_frames.empty(); }
+    bool is_finished() const { return m_next_frame >= m_frames.size(); }
+    int frame_count() const { return (int)m_frames.size(); }
+
+private:
+    std::vector<FrameInput> m_frames;
+    size_t m_next_frame = 0;
+};
@@ -1,31 +1,255 @@
 #include "log.h"
 
-#include "raylib.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
 
-#include <cstdarg>
-#include <string>
+// Bounded multi producer queue (Vyukov). Each cell's sequence tells producers and the consumer
+// whether the cell is free, being written or ready to read, so neither side ever takes a lock.
+struct LogCell
+{
+    std::atomic<uint64_t> sequence;
+    LogMessage message;
+};
 
-extern float g_since_start;
+constexpr uint64_t k_log_capacity = 1024;
+constexpr auto k_log_idle_sleep = std::chrono::milliseconds(1);
 
-void LogMat4(const char* name, const glm::mat4& m4)
+class AsyncLogger
+{
+public:
+    AsyncLogger()
+        : m_epoch(std::chrono::steady_clock::now())
+    {
+        for(uint64_t i = 0; i < k_log_capacity; ++i)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        m_thread = std::thread(&AsyncLogger::Run, this);
+    }
+
+    ~AsyncLogger()
+    {
+        m_stop_requested = true;
+        m_thread.join();
+    }
+
+    LogMessage* Claim()
+    {
+        uint64_t position = m_enqueue_position.load(std::memory_order_relaxed);
+        while(true)
+        {
+            LogCell& cell = m_cells[position & (k_log_capacity - 1)];
+            const uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const int64_t difference = (int64_t)sequence - (int64_t)position;
+            if(difference == 0)
+            {
+                if(m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.message.position = position;
+                    return &cell.message;
+                }
+            }
+            else if(difference < 0)
+            {
+                // the consumer is a whole ring behind, never block the caller
+                m_dropped_count.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            else
+            {
+                position = m_enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Publish(LogMessage* message)
+    {
+        LogCell& cell = m_cells[message->position & (k_log_capacity - 1)];
+        cell.sequence.store(message->position + 1, std::memory_order_release);
+    }
+
+    int64_t GetTimestamp() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+    }
+
+private:
+    void Run()
+    {
+        std::string text;
+        while(true)
+        {
+            // the stop flag is only honored once the ring is drained, so nothing logged before exit is lost
+            const bool is_stopping = m_stop_requested.load(std::memory_order_acquire);
+            if(WriteNext(text))
+            {
+                continue;
+            }
+
+            const uint64_t dropped = m_dropped_count.exchange(0, std::memory_order_relaxed);
+            if(dropped > 0)
+            {
+                std::fprintf(stderr, "WARNING: Log ring full, dropped %llu messages\n", (unsigned long long)dropped);
+            }
+
+            if(is_stopping)
+            {
+                return;
+            }
+
+            std::this_thread::sleep_for(k_log_idle_sleep);
+        }
+    }
+
+    bool WriteNext(std::string& text)
+    {
+        LogCell& cell = m_cells[m_dequeue_position & (k_log_capacity - 1)];
+        if(cell.sequence.load(std::memory_order_acquire) != m_dequeue_position + 1)
+        {
+            return false;
+        }
+
+        const LogMessage& message = cell.message;
+        FormatLogMessage(message, text);
+        static const char* level_names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+        std::FILE* file = message.level >= LogLevel::Warning ? stderr : stdout;
+        std::fprintf(file, "%s: %0.3f   %s\n", level_names[(int)message.level], message.timestamp_nanoseconds / 1000000000.0, text.c_str());
+
+        cell.sequence.store(m_dequeue_position + k_log_capacity, std::memory_order_release);
+        ++m_dequeue_position;
+        return true;
+    }
+
+    static void FormatLogMessage(const LogMessage& message, std::string& text);
+
+    LogCell m_cells[k_log_capacity];
+    alignas(64) std::atomic<uint64_t> m_enqueue_position = 0;
+    std::atomic<uint64_t> m_dropped_count = 0;
+    std::atomic<bool> m_stop_requested = false;
+    uint64_t m_dequeue_position = 0;
+    std::chrono::steady_clock::time_point m_epoch;
+    std::thread m_thread;
+};
+
+void AsyncLogger::FormatLogMessage(const LogMessage& message, std::string& text)
+{
+    // walks the format string and hands every conversion to snprintf with the argument type that was captured,
+    // length modifiers in the format are ignored since the captured types are already 64 bit
+    text.clear();
+    int arg_index = 0;
+    char buffer[256];
+    for(const char* p = message.format; *p; ++p)
+    {
+        if(*p != '%')
+        {
+            text += *p;
+            continue;
+        }
+
+        if(p[1] == '%')
+        {
+            text += '%';
+            ++p;
+            continue;
+        }
+
+        std::string spec = "%";
+        ++p;
+        while(*p && std::strchr("-+ #0123456789.", *p))
+        {
+            spec += *p++;
+        }
+
+        while(*p && std::strchr("hlLqjzt", *p))
+        {
+            ++p;
+        }
+
+        if(!*p)
+        {
+            break;
+        }
+
+        const char conversion = *p;
+        if(arg_index >= message.arg_count)
+        {
+            text += "<missing>";
+            continue;
+        }
+
+        const LogArg& arg = message.args[arg_index++];
+        const bool is_float_arg = arg.type == LogArgType::Float;
+        const int64_t integer_value = arg.type == LogArgType::Signed ? arg.signed_value : (int64_t)arg.unsigned_value;
+        switch(conversion)
+        {
+            case 'd':
+            case 'i':
+                std::snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), is_float_arg ? (long long)arg.float_value : (long long)integer_value);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                std::snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(), is_float_arg ? (unsigned long long)arg.float_value : (unsigned long long)integer_value);
+                break;
+            case 'c':
+                std::snprintf(buffer, sizeof(buffer), (spec + "c").c_str(), (int)integer_value);
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                std::snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), is_float_arg ? arg.float_value : (double)integer_value);
+                break;
+            case 's':
+                std::snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), arg.type == LogArgType::String ? message.strings + arg.string_offset : "<not a string>");
+                break;
+            case 'p':
+                std::snprintf(buffer, sizeof(buffer), "%p", arg.pointer_value);
+                break;
+            default:
+                std::snprintf(buffer, sizeof(buffer), "<%%%c?>", conversion);
+                break;
+        }
+
+        text += buffer;
+    }
+}
+
+std::atomic<LogLevel> g_log_level = LogLevel::Debug;
+AsyncLogger g_logger;
+
+void SetLogLevel(const LogLevel level)
 {
-    Log("%s:\n%f %f %f %f\n%f %f %f %f\n%f %f %f %f\n%f %f %f %f\n", name,
-        m4[0][0], m4[1][0], m4[2][0], m4[3][0],
-        m4[0][1], m4[1][1], m4[2][1], m4[3][1],
-        m4[0][2], m4[1][2], m4[2][2], m4[3][2],
-        m4[0][3], m4[1][3], m4[2][3], m4[3][3]
-    );
+    g_log_level.store(level, std::memory_order_relaxed);
 }
 
-void Log(const char* format, ...)
+LogMessage* ClaimLogMessage()
 {
-    char buffer[1024];
-    strcpy_s(buffer, 1024, "%0.3f   ");
+    return g_logger.Claim();
+}
 
-    va_list args;
-    va_start(args, format);
-    vsprintf_s(buffer + strlen(buffer), 1024 - strlen(buffer), format, args);
-    va_end(args);
+void PublishLogMessage(LogMessage* message)
+{
+    g_logger.Publish(message);
+}
 
-    TraceLog(LOG_DEBUG, buffer, g_since_start);
-}
\ No newline at end of file
+int64_t GetLogTimestamp()
+{
+    return g_logger.GetTimestamp();
+}
+
+void LogMat4(const char* name, const glm::mat4& m4)
+{
+    LogDebug("%s:", name);
+    for(int row = 0; row < 4; ++row)
+    {
+        LogDebug("%f %f %f %f", m4[0][row], m4[1][row], m4[2][row], m4[3][row]);
+    }
+}
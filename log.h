@@ -2,5 +2,187 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous printf style logging. The calling thread only captures the arguments, strings get
+// copied, into a slot of a lock-free multi producer ring. A background thread does the formatting
+// and the writing, debug and info to stdout, warnings and errors to stderr. Messages below
+// DEMO3D_LOG_LEVEL are compiled out, SetLogLevel filters the rest at runtime. When the ring is full
+// messages get dropped and counted rather than blocking the caller.
+
+enum class LogLevel
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+#ifndef DEMO3D_LOG_LEVEL
+#define DEMO3D_LOG_LEVEL 0
+#endif
+
+constexpr LogLevel k_min_log_level = (LogLevel)DEMO3D_LOG_LEVEL;
+constexpr int k_max_log_args = 16;
+constexpr int k_log_string_capacity = 256;
+
+enum class LogArgType : uint8_t
+{
+    Signed,
+    Unsigned,
+    Float,
+    String,
+    Pointer
+};
+
+struct LogArg
+{
+    LogArgType type;
+    union
+    {
+        int64_t signed_value;
+        uint64_t unsigned_value;
+        double float_value;
+        const void* pointer_value;
+        uint16_t string_offset;
+    };
+};
+
+struct LogMessage
+{
+    uint64_t position; // ring position, needed to publish the message
+    int64_t timestamp_nanoseconds;
+    const char* format; // must be a string literal or otherwise outlive the message
+    LogLevel level;
+    uint8_t arg_count;
+    uint16_t strings_size;
+    LogArg args[k_max_log_args];
+    char strings[k_log_string_capacity];
+};
+
+extern std::atomic<LogLevel> g_log_level;
+
+void SetLogLevel(const LogLevel level);
+// nullptr when the ring is full, the message is then counted as dropped
+LogMessage* ClaimLogMessage();
+void PublishLogMessage(LogMessage* message);
+
+int64_t GetLogTimestamp();
 void LogMat4(const char* name, const glm::mat4& m4);
-void Log(const char* format, ...);
\ No newline at end of file
+
+inline void CaptureLogString(LogMessage& message, LogArg& arg, std::string_view text)
+{
+    // strings are copied so the caller's buffers can go away before the message is formatted, long ones get cut
+    arg.type = LogArgType::String;
+    if(message.strings_size >= k_log_string_capacity - 1)
+    {
+        // no room left, later strings print empty through the last string's terminator
+        arg.string_offset = (uint16_t)(message.strings_size - 1);
+        return;
+    }
+
+    const size_t available = (size_t)k_log_string_capacity - message.strings_size - 1;
+    const size_t length = std::min(text.size(), available);
+    arg.string_offset = message.strings_size;
+    std::memcpy(message.strings + message.strings_size, text.data(), length);
+    message.strings[message.strings_size + length] = '\0';
+    message.strings_size += (uint16_t)(length + 1);
+}
+
+template<typename T>
+void CaptureLogArg(LogMessage& message, const T& value)
+{
+    LogArg& arg = message.args[message.arg_count++];
+    using Type = std::decay_t<T>;
+    if constexpr(std::is_same_v<Type, char*> || std::is_same_v<Type, const char*>)
+    {
+        CaptureLogString(message, arg, value ? std::string_view{value} : std::string_view{"(null)"});
+    }
+    else if constexpr(std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view>)
+    {
+        CaptureLogString(message, arg, value);
+    }
+    else if constexpr(std::is_floating_point_v<Type>)
+    {
+        arg.type = LogArgType::Float;
+        arg.float_value = (double)value;
+    }
+    else if constexpr(std::is_enum_v<Type>)
+    {
+        arg.type = LogArgType::Signed;
+        arg.signed_value = (int64_t)value;
+    }
+    else if constexpr(std::is_integral_v<Type> && std::is_signed_v<Type>)
+    {
+        arg.type = LogArgType::Signed;
+        arg.signed_value = (int64_t)value;
+    }
+    else if constexpr(std::is_integral_v<Type>)
+    {
+        arg.type = LogArgType::Unsigned;
+        arg.unsigned_value = (uint64_t)value;
+    }
+    else
+    {
+        static_assert(std::is_pointer_v<Type>, "Log only takes numbers, strings and pointers");
+        arg.type = LogArgType::Pointer;
+        arg.pointer_value = (const void*)value;
+    }
+}
+
+template<LogLevel level, typename... Args>
+void LogAt(const char* format, const Args&... args)
+{
+    static_assert(sizeof...(Args) <= k_max_log_args, "Too many arguments for one log message");
+    if constexpr(level >= k_min_log_level)
+    {
+        if(level < g_log_level.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        LogMessage* message = ClaimLogMessage();
+        if(!message)
+        {
+            return;
+        }
+
+        message->timestamp_nanoseconds = GetLogTimestamp();
+        message->format = format;
+        message->level = level;
+        message->arg_count = 0;
+        message->strings_size = 0;
+        (CaptureLogArg(*message, args), ...);
+        PublishLogMessage(message);
+    }
+}
+
+template<typename... Args>
+void LogDebug(const char* format, const Args&... args)
+{
+    LogAt<LogLevel::Debug>(format, args...);
+}
+
+template<typename... Args>
+void Log(const char* format, const Args&... args)
+{
+    LogAt<LogLevel::Info>(format, args...);
+}
+
+template<typename... Args>
+void LogWarning(const char* format, const Args&... args)
+{
+    LogAt<LogLevel::Warning>(format, args...);
+}
+
+template<typename... Args>
+void LogError(const char* format, const Args&... args)
+{
+    LogAt<LogLevel::Error>(format, args...);
+}
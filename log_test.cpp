@@ -0,0 +1,79 @@
+#include "log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Over-long string arguments have to be cut to the message's string buffer without writing past it.
+// A stray write lands in the next ring cell's sequence and the next Log spins forever, so the test
+// logs through the ring afterwards too and relies on the CTest timeout to catch a hang.
+
+struct GuardedLogMessage
+{
+    LogMessage message;
+    uint64_t guard;
+};
+
+constexpr uint64_t k_guard_value = 0x0123456789abcdefull;
+
+int g_failed_count = 0;
+
+void Check(const bool condition, const char* description)
+{
+    if(!condition)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", description);
+        ++g_failed_count;
+    }
+}
+
+void TestCaptureLongStrings()
+{
+    const std::string long_text(300, 'a');
+    const std::string short_text(10, 'b');
+    const char* c_text = "c string";
+    GuardedLogMessage guarded = {};
+    guarded.guard = k_guard_value;
+    LogMessage& message = guarded.message;
+    CaptureLogArg(message, long_text);
+    CaptureLogArg(message, long_text);
+    CaptureLogArg(message, short_text);
+    CaptureLogArg(message, c_text);
+
+    Check(guarded.guard == k_guard_value, "strings stay inside the message");
+    Check(message.strings_size <= k_log_string_capacity, "strings_size stays within the capacity");
+    for(int i = 0; i < message.arg_count; ++i)
+    {
+        Check(message.args[i].string_offset < k_log_string_capacity, "string offsets point into the buffer");
+    }
+
+    Check(std::string(message.strings + message.args[0].string_offset) == std::string(k_log_string_capacity - 1, 'a'), "the first string gets cut to the capacity");
+    for(int i = 1; i < message.arg_count; ++i)
+    {
+        Check(message.strings[message.args[i].string_offset] == '\0', "strings past the capacity are empty");
+    }
+}
+
+void TestLogAfterLongStrings()
+{
+    const std::string long_text(300, 'a');
+    for(int i = 0; i < 4; ++i)
+    {
+        Log("%s %s %s %s", long_text, long_text, std::string(10, 'b'), long_text);
+        Log("after %d", i);
+    }
+}
+
+int main()
+{
+    TestCaptureLongStrings();
+    TestLogAfterLongStrings();
+    if(g_failed_count > 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", g_failed_count);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("All log checks passed\n");
+    return EXIT_SUCCESS;
+}
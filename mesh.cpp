@@ -0,0 +1,222 @@
+#include "mesh.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+MyMesh ParseObjFile(const std::filesystem::path& path)
+{
+    std::fstream in{path, std::ios::in};
+    std::string line;
+
+    int vertex_count = 0;
+    int normal_count = 0;
+    int uv_count = 0;
+    int triangle_count = 0;
+
+    while(std::getline(in, line))
+    {
+        if(line.at(0) == 'v' && line.at(1) == 'n')
+        {
+            ++normal_count;
+        }
+        else if(line.at(0) == 'v' && line.at(1) == 't')
+        {
+            ++uv_count;
+        }
+        else if(line.at(0) == 'v')
+        {
+            ++vertex_count;
+        }
+        else if(line.at(0) == 'f')
+        {
+            ++triangle_count;
+        }
+        else if(line.at(0) == 's')
+        {
+            Log("Shading type %s", line.substr(2).c_str());
+        }
+        else if(line.at(0) == 'o')
+        {
+            Log("Parsing object %s", line.substr(2).c_str());
+        }
+    }
+
+    in.clear();
+    in.seekg(0, std::ios::beg);
+
+    MyMesh mesh{vertex_count, normal_count, uv_count, triangle_count};
+
+    Log("Mesh Details:\n"
+        "Vertices: %d\n"
+        "Normals: %d\n"
+        "UVs: %d\n"
+        "Triangles: %d\n",
+        vertex_count, normal_count, uv_count, triangle_count);
+
+    vertex_count = 0;
+    normal_count = 0;
+    uv_count = 0;
+    triangle_count = 0;
+
+    while(std::getline(in, line))
+    {
+        float x, y, z;
+        std::stringstream ss;
+        ss << line;
+        if(line.at(0) == 'v' && line.at(1) == 'n')
+        {
+            // parse normal
+            ss.ignore(2);
+            ss >> x >> y >> z;
+            mesh.m_data->normals[normal_count * 3 + 0] = x;
+            mesh.m_data->normals[normal_count * 3 + 1] = y;
+            mesh.m_data->normals[normal_count * 3 + 2] = z;
+            ++normal_count;
+        }
+        else if(line.at(0) == 'v' && line.at(1) == 't')
+        {
+            // parse uv
+            ss.ignore(2);
+            ss >> x >> y;
+            mesh.m_data->uvs[uv_count * 2 + 0] = x;
+            mesh.m_data->uvs[uv_count * 2 + 1] = y;
+            ++uv_count;
+        }
+        else if(line.at(0) == 'v')
+        {
+            // parse vertex
+            ss.ignore(1);
+            ss >> x >> y >> z;
+            mesh.m_data->vertices[vertex_count * 3 + 0] = x;
+            mesh.m_data->vertices[vertex_count * 3 + 1] = y;
+            mesh.m_data->vertices[vertex_count * 3 + 2] = z;
+            ++vertex_count;
+        }
+        else if(line.at(0) == 'f')
+        {
+            // parse triangle
+            ss.ignore(1);
+            int vertex_index;
+            int uv_index;
+            int normal_index;
+            std::string group1, group2, group3;
+            ss >> group1 >> group2 >> group3;
+
+            std::string_view groups[] = {group1, group2, group3};
+            for(int i = 0; i < 3; ++i)
+            {
+                std::stringstream ss1;
+                ss1 << groups[i];
+                ss1 >> vertex_index;
+                ss1.ignore(1); // ignore the '/' character
+                ss1 >> uv_index;
+                ss1.ignore(1); // ignore the '/' character
+                ss1 >> normal_index;
+                
+                --vertex_index; --uv_index; --normal_index; // OBJ format is 1-indexed
+                const int index_size = mesh.m_data->index_size;
+                MyMesh::StoreIndex(mesh.m_data->vertex_indices, index_size, triangle_count * 3 + i, vertex_index);
+                MyMesh::StoreIndex(mesh.m_data->uv_indices, index_size, triangle_count * 3 + i, uv_index);
+                MyMesh::StoreIndex(mesh.m_data->normal_indices, index_size, triangle_count * 3 + i, normal_index);
+            }
+
+            ++triangle_count;
+        }
+    }
+
+    return mesh;
+}
+
+void EncodeOctahedral(const float* normal, float* encoded)
+{
+    const float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    float x = length > 0 ? normal[0] / length : 0.0f;
+    float y = length > 0 ? normal[1] / length : 0.0f;
+    if(normal[2] < 0)
+    {
+        const float folded_x = (1.0f - std::abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+        const float folded_y = (1.0f - std::abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    encoded[0] = x;
+    encoded[1] = y;
+}
+
+void DecodeOctahedral(const float x, const float y, float* normal)
+{
+    const float z = 1.0f - std::abs(x) - std::abs(y);
+    const float t = std::max(-z, 0.0f);
+    const float nx = x + (x >= 0 ? -t : t);
+    const float ny = y + (y >= 0 ? -t : t);
+    const float length_recip = 1.0f / std::sqrt(nx * nx + ny * ny + z * z);
+    normal[0] = nx * length_recip;
+    normal[1] = ny * length_recip;
+    normal[2] = z * length_recip;
+}
+
+MyMesh CompressMesh(const MyMesh& mesh, const VertexFormat format)
+{
+    if(format == VertexFormat::Float || mesh.vertex_format() != VertexFormat::Float)
+    {
+        return mesh;
+    }
+
+    MyMesh compressed{mesh.vertex_count(), mesh.normal_count(), mesh.uv_count(), mesh.triangle_count(), format};
+    auto& data = *compressed.m_data;
+    const auto& source = *mesh.m_data;
+
+    // quantize the attributes relative to their bounds so all 16 bits carry precision
+    const auto Quantize = [](const std::span<const float> values, const int components, float* scale, float* offset, std::span<uint16_t> quantized){
+        for(int c = 0; c < components; ++c)
+        {
+            float min_value = values.empty() ? 0.0f : values[c];
+            float max_value = min_value;
+            for(size_t i = c; i < values.size(); i += components)
+            {
+                min_value = std::min(min_value, values[i]);
+                max_value = std::max(max_value, values[i]);
+            }
+
+            const float extent = max_value - min_value;
+            const float quantize_scale = extent > 0 ? 65535.0f / extent : 0.0f;
+            for(size_t i = c; i < values.size(); i += components)
+            {
+                quantized[i] = (uint16_t)std::lround((values[i] - min_value) * quantize_scale);
+            }
+
+            scale[c] = extent / 65535.0f;
+            offset[c] = min_value;
+        }
+    };
+
+    Quantize(source.vertices, 3, data.position_scale, data.position_offset, data.quantized_vertices);
+    Quantize(source.uvs, 2, data.uv_scale, data.uv_offset, data.quantized_uvs);
+
+    for(int i = 0; i < mesh.normal_count(); ++i)
+    {
+        float encoded[2];
+        EncodeOctahedral(&source.normals[i * 3], encoded);
+        for(int c = 0; c < 2; ++c)
+        {
+            if(format == VertexFormat::Compressed)
+            {
+                data.oct16_normals[i * 2 + c] = (int16_t)std::lround(std::clamp(encoded[c], -1.0f, 1.0f) * 32767.0f);
+            }
+            else
+            {
+                data.oct8_normals[i * 2 + c] = (int8_t)std::lround(std::clamp(encoded[c], -1.0f, 1.0f) * 127.0f);
+            }
+        }
+    }
+
+    std::copy(source.vertex_indices.begin(), source.vertex_indices.end(), data.vertex_indices.begin());
+    std::copy(source.uv_indices.begin(), source.uv_indices.end(), data.uv_indices.begin());
+    std::copy(source.normal_indices.begin(), source.normal_indices.end(), data.normal_indices.begin());
+
+    Log("Compressed mesh vertices from %zu to %zu bytes", mesh.memory_size(), compressed.memory_size());
+    return compressed;
+}
@@ -2,14 +2,36 @@
 
 #include "log.h"
 
-#include <fstream>
+#include "glm/mat4x4.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <sstream>
-#include <string>
+#include <memory>
+#include <new>
+#include <span>
 
 class MyMesh;
 MyMesh ParseObjFile(const std::filesystem::path& path);
 
+enum class VertexFormat
+{
+    Float,           // 32-bit float positions, normals and uvs
+    Compressed,      // 16-bit positions in the mesh bounds, 2x16-bit octahedral normals, unorm16 uvs
+    CompressedOct8   // same as Compressed with 2x8-bit octahedral normals
+};
+
+// Re-encodes the vertex attributes of a float mesh into one of the compressed formats
+MyMesh CompressMesh(const MyMesh& mesh, const VertexFormat format);
+
+// Octahedral encoding folds the unit sphere onto a square so a normal fits in two components
+void EncodeOctahedral(const float* normal, float* encoded);
+void DecodeOctahedral(const float x, const float y, float* normal);
+
+// Positions are in the mesh's storage space, transform them with MyMesh::position_decode_matrix.
+// Index must match the mesh's index type, see VisitIndexType.
+template<typename Index>
 void GetMeshTriangle(const MyMesh& mesh, const int triangle_index, float* vertices, float* uvs, float* normals);
 
 class MyMesh
@@ -17,270 +39,256 @@ class MyMesh
 public:
     MyMesh() = default;
 
-    MyMesh(const int vertex_count, const int normal_count, const int uv_count, const int triangle_count)
-        : m_vertices(new float[vertex_count * 3]),
-          m_normals(new float[normal_count * 3]),
-          m_uvs(new float[uv_count * 2]),
-          m_vertex_indices(new uint32_t[triangle_count * 3]),
-          m_uv_indices(new uint32_t[triangle_count * 3]),
-          m_normal_indices(new uint32_t[triangle_count * 3]),
-          m_vertex_count(vertex_count),
-          m_normal_count(normal_count),
-          m_uv_count(uv_count),
-          m_triangle_count(triangle_count)
+    // All arrays are carved out of one 64-byte aligned allocation. Copies of a mesh
+    // share that allocation, the data is never modified once parsing is done.
+    MyMesh(const int vertex_count, const int normal_count, const int uv_count, const int triangle_count, const VertexFormat format = VertexFormat::Float)
+        : m_data(std::make_shared<Data>())
     {
-    }
+        const bool is_compressed = format != VertexFormat::Float;
+        const size_t float_vertex_count = is_compressed ? 0 : vertex_count;
+        const size_t float_normal_count = is_compressed ? 0 : normal_count;
+        const size_t float_uv_count = is_compressed ? 0 : uv_count;
+        const size_t quantized_vertex_count = is_compressed ? vertex_count : 0;
+        const size_t oct16_normal_count = format == VertexFormat::Compressed ? normal_count : 0;
+        const size_t oct8_normal_count = format == VertexFormat::CompressedOct8 ? normal_count : 0;
+        const size_t quantized_uv_count = is_compressed ? uv_count : 0;
 
-    MyMesh(MyMesh&& other)
-    {
-        *this = std::move(other);
-    }
+        size_t arena_size = 0;
+        const auto Reserve = [&arena_size](const size_t bytes){
+            const size_t offset = arena_size;
+            arena_size += (bytes + k_arena_alignment - 1) & ~(k_arena_alignment - 1);
+            return offset;
+        };
 
-    ~MyMesh()
-    {
-        FreeMemory();
+        const size_t vertices_offset = Reserve(sizeof(float) * float_vertex_count * 3);
+        const size_t normals_offset = Reserve(sizeof(float) * float_normal_count * 3);
+        const size_t uvs_offset = Reserve(sizeof(float) * float_uv_count * 2);
+        const size_t quantized_vertices_offset = Reserve(sizeof(uint16_t) * quantized_vertex_count * 3);
+        const size_t oct16_normals_offset = Reserve(sizeof(int16_t) * oct16_normal_count * 2);
+        const size_t oct8_normals_offset = Reserve(sizeof(int8_t) * oct8_normal_count * 2);
+        const size_t quantized_uvs_offset = Reserve(sizeof(uint16_t) * quantized_uv_count * 2);
+        // use the narrowest index type every attribute's count fits in
+        const int max_count = std::max({vertex_count, normal_count, uv_count});
+        const int index_size = max_count <= 0x100 ? 1 : max_count <= 0x10000 ? 2 : 4;
+        const size_t index_bytes = (size_t)index_size * triangle_count * 3;
+        const size_t vertex_indices_offset = Reserve(index_bytes);
+        const size_t uv_indices_offset = Reserve(index_bytes);
+        const size_t normal_indices_offset = Reserve(index_bytes);
+
+        std::byte* arena = static_cast<std::byte*>(::operator new(arena_size, std::align_val_t{k_arena_alignment}));
+        m_data->arena.reset(arena);
+        m_data->arena_size = arena_size;
+        m_data->vertices = Carve<float>(arena, vertices_offset, float_vertex_count * 3);
+        m_data->normals = Carve<float>(arena, normals_offset, float_normal_count * 3);
+        m_data->uvs = Carve<float>(arena, uvs_offset, float_uv_count * 2);
+        m_data->quantized_vertices = Carve<uint16_t>(arena, quantized_vertices_offset, quantized_vertex_count * 3);
+        m_data->oct16_normals = Carve<int16_t>(arena, oct16_normals_offset, oct16_normal_count * 2);
+        m_data->oct8_normals = Carve<int8_t>(arena, oct8_normals_offset, oct8_normal_count * 2);
+        m_data->quantized_uvs = Carve<uint16_t>(arena, quantized_uvs_offset, quantized_uv_count * 2);
+        m_data->vertex_indices = Carve<std::byte>(arena, vertex_indices_offset, index_bytes);
+        m_data->uv_indices = Carve<std::byte>(arena, uv_indices_offset, index_bytes);
+        m_data->normal_indices = Carve<std::byte>(arena, normal_indices_offset, index_bytes);
+        m_data->index_size = index_size;
+        m_data->vertex_count = vertex_count;
+        m_data->normal_count = normal_count;
+        m_data->uv_count = uv_count;
+        m_data->triangle_count = triangle_count;
+        m_data->format = format;
     }
 
-    MyMesh& operator=(MyMesh&& other)
+    std::span<const float> vertices() const { return m_data ? m_data->vertices : std::span<const float>{}; }
+    std::span<const float> normals() const { return m_data ? m_data->normals : std::span<const float>{}; }
+    std::span<const float> uvs() const { return m_data ? m_data->uvs : std::span<const float>{}; }
+    std::span<const uint16_t> quantized_vertices() const { return m_data ? m_data->quantized_vertices : std::span<const uint16_t>{}; }
+    std::span<const int16_t> oct16_normals() const { return m_data ? m_data->oct16_normals : std::span<const int16_t>{}; }
+    std::span<const int8_t> oct8_normals() const { return m_data ? m_data->oct8_normals : std::span<const int8_t>{}; }
+    std::span<const uint16_t> quantized_uvs() const { return m_data ? m_data->quantized_uvs : std::span<const uint16_t>{}; }
+    template<typename Index> std::span<const Index> vertex_indices() const { return m_data ? AsIndices<const Index>(m_data->vertex_indices) : std::span<const Index>{}; }
+    template<typename Index> std::span<const Index> uv_indices() const { return m_data ? AsIndices<const Index>(m_data->uv_indices) : std::span<const Index>{}; }
+    template<typename Index> std::span<const Index> normal_indices() const { return m_data ? AsIndices<const Index>(m_data->normal_indices) : std::span<const Index>{}; }
+
+    int vertex_count() const { return m_data ? m_data->vertex_count : 0; }
+    int normal_count() const { return m_data ? m_data->normal_count : 0; }
+    int uv_count() const { return m_data ? m_data->uv_count : 0; }
+    int triangle_count() const { return m_data ? m_data->triangle_count : 0; }
+    size_t memory_size() const { return m_data ? m_data->arena_size : 0; }
+    // 1, 2 or 4 bytes, picked from the attribute counts when the mesh is created
+    int index_size() const { return m_data ? m_data->index_size : 4; }
+    VertexFormat vertex_format() const { return m_data ? m_data->format : VertexFormat::Float; }
+
+    // Maps positions as they are stored to object space, identity for float meshes.
+    // Folding this into the world to screen matrix decodes quantized positions for free.
+    glm::mat4 position_decode_matrix() const
     {
-        if(this != &other)
+        if(!m_data)
         {
-            FreeMemory();
-            m_vertices = other.m_vertices;
-            m_normals = other.m_normals;
-            m_uvs = other.m_uvs;
-            m_vertex_indices = other.m_vertex_indices;
-            m_normal_indices = other.m_normal_indices;
-            m_uv_indices = other.m_uv_indices;
-            m_vertex_count = other.m_vertex_count;
-            m_normal_count = other.m_normal_count;
-            m_uv_count = other.m_uv_count;
-            m_triangle_count = other.m_triangle_count;
-
-            other.m_vertices = nullptr;
-            other.m_normals = nullptr;
-            other.m_uvs = nullptr;
-            other.m_vertex_indices = nullptr;
-            other.m_normal_indices = nullptr;
-            other.m_uv_indices = nullptr;
-            other.m_vertex_count = 0;
-            other.m_normal_count = 0;
-            other.m_uv_count = 0;
-            other.m_triangle_count = 0;
+            return glm::mat4(1.0f);
         }
 
-        return *this;
+        const float* scale = m_data->position_scale;
+        const float* offset = m_data->position_offset;
+        return glm::mat4{
+            scale[0], 0, 0, 0,
+            0, scale[1], 0, 0,
+            0, 0, scale[2], 0,
+            offset[0], offset[1], offset[2], 1
+        };
     }
 
-    int vertex_count() const { return m_vertex_count; }
-    int normal_count() const { return m_normal_count; }
-    int uv_count() const { return m_uv_count; }
-    int triangle_count() const { return m_triangle_count; }
-
 private:
-    void FreeMemory()
-    {
-        if(m_vertices)
-            delete[] m_vertices;
-        if(m_normals)
-            delete[] m_normals;
-        if(m_uvs)
-            delete[] m_uvs;
-        if(m_vertex_indices)
-            delete[] m_vertex_indices;
-        if(m_uv_indices)
-            delete[] m_uv_indices;
-        if(m_normal_indices)
-            delete[] m_normal_indices;
-
-        m_vertices = nullptr;
-        m_normals = nullptr;
-        m_uvs = nullptr;
-        m_vertex_indices = nullptr;
-        m_uv_indices = nullptr;
-        m_vertex_count = 0;
-        m_normal_count = 0;
-        m_uv_count = 0;
-        m_triangle_count = 0;
-    }
+    static constexpr size_t k_arena_alignment = 64;
 
-    float* m_vertices = nullptr;
-    float* m_normals = nullptr;
-    float* m_uvs = nullptr;
-    uint32_t* m_vertex_indices = nullptr;
-    uint32_t* m_uv_indices = nullptr;
-    uint32_t* m_normal_indices = nullptr;
-    int m_vertex_count = 0;
-    int m_normal_count = 0;
-    int m_uv_count = 0;
-    int m_triangle_count = 0;
+    struct ArenaDeleter
+    {
+        void operator()(std::byte* arena) const { ::operator delete(arena, std::align_val_t{k_arena_alignment}); }
+    };
 
-    friend MyMesh ParseObjFile(const std::filesystem::path& path);
-    friend void GetMeshTriangle(const MyMesh& mesh, const int triangle_index, float* vertices, float* uvs, float* normals);
-};
+    struct Data
+    {
+        std::unique_ptr<std::byte, ArenaDeleter> arena;
+        size_t arena_size = 0;
+        std::span<float> vertices;
+        std::span<float> normals;
+        std::span<float> uvs;
+        std::span<uint16_t> quantized_vertices;
+        std::span<int16_t> oct16_normals;
+        std::span<int8_t> oct8_normals;
+        std::span<uint16_t> quantized_uvs;
+        std::span<std::byte> vertex_indices;
+        std::span<std::byte> uv_indices;
+        std::span<std::byte> normal_indices;
+        int index_size = 4;
+        int vertex_count = 0;
+        int normal_count = 0;
+        int uv_count = 0;
+        int triangle_count = 0;
+        VertexFormat format = VertexFormat::Float;
+        float position_scale[3] = {1, 1, 1};
+        float position_offset[3] = {0, 0, 0};
+        float uv_scale[2] = {1, 1};
+        float uv_offset[2] = {0, 0};
+    };
 
-MyMesh ParseObjFile(const std::filesystem::path& path)
-{
-    std::fstream in{path, std::ios::in};
-    std::string line;
+    template<typename T>
+    static std::span<T> Carve(std::byte* arena, const size_t offset, const size_t count)
+    {
+        return {reinterpret_cast<T*>(arena + offset), count};
+    }
 
-    int vertex_count = 0;
-    int normal_count = 0;
-    int uv_count = 0;
-    int triangle_count = 0;
+    template<typename Index, typename Byte>
+    static std::span<Index> AsIndices(const std::span<Byte> bytes)
+    {
+        return {reinterpret_cast<Index*>(bytes.data()), bytes.size() / sizeof(Index)};
+    }
 
-    while(std::getline(in, line))
+    static void StoreIndex(const std::span<std::byte> indices, const int index_size, const size_t i, const uint32_t value)
     {
-        if(line.at(0) == 'v' && line.at(1) == 'n')
+        switch(index_size)
         {
-            ++normal_count;
-        }
-        else if(line.at(0) == 'v' && line.at(1) == 't')
-        {
-            ++uv_count;
-        }
-        else if(line.at(0) == 'v')
-        {
-            ++vertex_count;
-        }
-        else if(line.at(0) == 'f')
-        {
-            ++triangle_count;
-        }
-        else if(line.at(0) == 's')
-        {
-            Log("Shading type %s", line.substr(2).c_str());
-        }
-        else if(line.at(0) == 'o')
-        {
-            Log("Parsing object %s", line.substr(2).c_str());
+            case 1: AsIndices<uint8_t>(indices)[i] = (uint8_t)value; break;
+            case 2: AsIndices<uint16_t>(indices)[i] = (uint16_t)value; break;
+            default: AsIndices<uint32_t>(indices)[i] = value; break;
         }
     }
 
-    in.clear();
-    in.seekg(0, std::ios::beg);
-
-    MyMesh mesh{vertex_count, normal_count, uv_count, triangle_count};
+    std::shared_ptr<Data> m_data;
 
-    Log("Mesh Details:\n"
-        "Vertices: %d\n"
-        "Normals: %d\n"
-        "UVs: %d\n"
-        "Triangles: %d\n",
-        vertex_count, normal_count, uv_count, triangle_count);
+    friend MyMesh ParseObjFile(const std::filesystem::path& path);
+    friend MyMesh CompressMesh(const MyMesh& mesh, const VertexFormat format);
+    friend MyMesh OptimizeMesh(const MyMesh& mesh);
+    template<typename Index>
+    friend void GetMeshTriangle(const MyMesh& mesh, const int triangle_index, float* vertices, float* uvs, float* normals);
+};
 
-    vertex_count = 0;
-    normal_count = 0;
-    uv_count = 0;
-    triangle_count = 0;
+// Calls function with a value of the mesh's index type, so loops over triangles can be
+// specialized on it instead of branching on the index size per triangle
+template<typename Function>
+void VisitIndexType(const MyMesh& mesh, Function&& function)
+{
+    switch(mesh.index_size())
+    {
+        case 1: function(uint8_t{}); break;
+        case 2: function(uint16_t{}); break;
+        default: function(uint32_t{}); break;
+    }
+}
 
-    while(std::getline(in, line))
+template<typename Index>
+void GetMeshTriangle(const MyMesh& mesh, const int triangle_index, float* vertices, float* uvs, float* normals)
+{
+    const auto& data = *mesh.m_data;
+    const Index* vertex_indices = reinterpret_cast<const Index*>(data.vertex_indices.data());
+    const Index* uv_indices = reinterpret_cast<const Index*>(data.uv_indices.data());
+    const Index* normal_indices = reinterpret_cast<const Index*>(data.normal_indices.data());
+    if(data.format != VertexFormat::Float)
     {
-        float x, y, z;
-        std::stringstream ss;
-        ss << line;
-        if(line.at(0) == 'v' && line.at(1) == 'n')
+        // like the float path below, the first corner's normal is used for the whole face
+        const uint32_t n1 = normal_indices[triangle_index * 3 + 0];
+        float normal[3];
+        if(data.format == VertexFormat::Compressed)
         {
-            // parse normal
-            ss.ignore(2);
-            ss >> x >> y >> z;
-            mesh.m_normals[normal_count * 3 + 0] = x;
-            mesh.m_normals[normal_count * 3 + 1] = y;
-            mesh.m_normals[normal_count * 3 + 2] = z;
-            ++normal_count;
+            DecodeOctahedral(data.oct16_normals[n1 * 2 + 0] / 32767.0f, data.oct16_normals[n1 * 2 + 1] / 32767.0f, normal);
         }
-        else if(line.at(0) == 'v' && line.at(1) == 't')
+        else
         {
-            // parse uv
-            ss.ignore(2);
-            ss >> x >> y;
-            mesh.m_uvs[uv_count * 2 + 0] = x;
-            mesh.m_uvs[uv_count * 2 + 1] = y;
-            ++uv_count;
+            DecodeOctahedral(data.oct8_normals[n1 * 2 + 0] / 127.0f, data.oct8_normals[n1 * 2 + 1] / 127.0f, normal);
         }
-        else if(line.at(0) == 'v')
+
+        for(int k = 0; k < 3; ++k)
         {
-            // parse vertex
-            ss.ignore(1);
-            ss >> x >> y >> z;
-            mesh.m_vertices[vertex_count * 3 + 0] = x;
-            mesh.m_vertices[vertex_count * 3 + 1] = y;
-            mesh.m_vertices[vertex_count * 3 + 2] = z;
-            ++vertex_count;
+            // positions stay quantized, position_decode_matrix takes them to object space
+            const uint32_t v = vertex_indices[triangle_index * 3 + k];
+            const uint32_t uv = uv_indices[triangle_index * 3 + k];
+            vertices[k * 3 + 0] = data.quantized_vertices[v * 3 + 0];
+            vertices[k * 3 + 1] = data.quantized_vertices[v * 3 + 1];
+            vertices[k * 3 + 2] = data.quantized_vertices[v * 3 + 2];
+            normals[k * 3 + 0] = normal[0];
+            normals[k * 3 + 1] = normal[1];
+            normals[k * 3 + 2] = normal[2];
+            uvs[k * 2 + 0] = data.quantized_uvs[uv * 2 + 0] * data.uv_scale[0] + data.uv_offset[0];
+            uvs[k * 2 + 1] = data.quantized_uvs[uv * 2 + 1] * data.uv_scale[1] + data.uv_offset[1];
         }
-        else if(line.at(0) == 'f')
-        {
-            // parse triangle
-            ss.ignore(1);
-            int vertex_index;
-            int uv_index;
-            int normal_index;
-            std::string group1, group2, group3;
-            ss >> group1 >> group2 >> group3;
-
-            std::string_view groups[] = {group1, group2, group3};
-            for(int i = 0; i < 3; ++i)
-            {
-                std::stringstream ss1;
-                ss1 << groups[i];
-                ss1 >> vertex_index;
-                ss1.ignore(1); // ignore the '/' character
-                ss1 >> uv_index;
-                ss1.ignore(1); // ignore the '/' character
-                ss1 >> normal_index;
-                
-                --vertex_index; --uv_index; --normal_index; // OBJ format is 1-indexed
-                mesh.m_vertex_indices[triangle_count * 3 + i] = vertex_index;
-                mesh.m_uv_indices[triangle_count * 3 + i] = uv_index;
-                mesh.m_normal_indices[triangle_count * 3 + i] = normal_index;
-            }
 
-            ++triangle_count;
-        }
+        return;
     }
 
-    return mesh;
-}
-
-void GetMeshTriangle(const MyMesh& mesh, const int triangle_index, float* vertices, float* uvs, float* normals)
-{
-    const uint32_t v1 = mesh.m_vertex_indices[triangle_index * 3 + 0];
-    const uint32_t v2 = mesh.m_vertex_indices[triangle_index * 3 + 1];
-    const uint32_t v3 = mesh.m_vertex_indices[triangle_index * 3 + 2];
-    const uint32_t n1 = mesh.m_normal_indices[triangle_index * 3 + 0];
-    const uint32_t n2 = mesh.m_normal_indices[triangle_index * 3 + 1];
-    const uint32_t n3 = mesh.m_normal_indices[triangle_index * 3 + 2];
-    const uint32_t uv1 = mesh.m_uv_indices[triangle_index * 3 + 0];
-    const uint32_t uv2 = mesh.m_uv_indices[triangle_index * 3 + 1];
-    const uint32_t uv3 = mesh.m_uv_indices[triangle_index * 3 + 2];
+    const uint32_t v1 = vertex_indices[triangle_index * 3 + 0];
+    const uint32_t v2 = vertex_indices[triangle_index * 3 + 1];
+    const uint32_t v3 = vertex_indices[triangle_index * 3 + 2];
+    const uint32_t n1 = normal_indices[triangle_index * 3 + 0];
+    const uint32_t n2 = normal_indices[triangle_index * 3 + 1];
+    const uint32_t n3 = normal_indices[triangle_index * 3 + 2];
+    const uint32_t uv1 = uv_indices[triangle_index * 3 + 0];
+    const uint32_t uv2 = uv_indices[triangle_index * 3 + 1];
+    const uint32_t uv3 = uv_indices[triangle_index * 3 + 2];
 
     // Vertex 1
-    vertices[0] = mesh.m_vertices[v1 * 3 + 0]; // x
-    vertices[1] = mesh.m_vertices[v1 * 3 + 1]; // y
-    vertices[2] = mesh.m_vertices[v1 * 3 + 2]; // z
-    normals[0] = mesh.m_normals[n1 * 3 + 0];   // normal x
-    normals[1] = mesh.m_normals[n1 * 3 + 1];   // normal y
-    normals[2] = mesh.m_normals[n1 * 3 + 2];   // normal z
-    uvs[0] = mesh.m_uvs[uv1 * 2 + 0];          // texcoord x
-    uvs[1] = mesh.m_uvs[uv1 * 2 + 1];          // texcoord y
+    vertices[0] = data.vertices[v1 * 3 + 0]; // x
+    vertices[1] = data.vertices[v1 * 3 + 1]; // y
+    vertices[2] = data.vertices[v1 * 3 + 2]; // z
+    normals[0] = data.normals[n1 * 3 + 0];   // normal x
+    normals[1] = data.normals[n1 * 3 + 1];   // normal y
+    normals[2] = data.normals[n1 * 3 + 2];   // normal z
+    uvs[0] = data.uvs[uv1 * 2 + 0];          // texcoord x
+    uvs[1] = data.uvs[uv1 * 2 + 1];          // texcoord y
     
     // Vertex 2
-    vertices[3] = mesh.m_vertices[v2 * 3 + 0];
-    vertices[4] = mesh.m_vertices[v2 * 3 + 1];
-    vertices[5] = mesh.m_vertices[v2 * 3 + 2];
-    normals[3] = mesh.m_normals[n1 * 3 + 0];
-    normals[4] = mesh.m_normals[n1 * 3 + 1];
-    normals[5] = mesh.m_normals[n1 * 3 + 2];
-    uvs[2] = mesh.m_uvs[uv2 * 2 + 0];
-    uvs[3] = mesh.m_uvs[uv2 * 2 + 1];
+    vertices[3] = data.vertices[v2 * 3 + 0];
+    vertices[4] = data.vertices[v2 * 3 + 1];
+    vertices[5] = data.vertices[v2 * 3 + 2];
+    normals[3] = data.normals[n1 * 3 + 0];
+    normals[4] = data.normals[n1 * 3 + 1];
+    normals[5] = data.normals[n1 * 3 + 2];
+    uvs[2] = data.uvs[uv2 * 2 + 0];
+    uvs[3] = data.uvs[uv2 * 2 + 1];
     
     // Vertex 3
-    vertices[6] = mesh.m_vertices[v3 * 3 + 0];
-    vertices[7] = mesh.m_vertices[v3 * 3 + 1];
-    vertices[8] = mesh.m_vertices[v3 * 3 + 2];
-    normals[6] = mesh.m_normals[n1 * 3 + 0];
-    normals[7] = mesh.m_normals[n1 * 3 + 1];
-    normals[8] = mesh.m_normals[n1 * 3 + 2];
-    uvs[4] = mesh.m_uvs[uv3 * 2 + 0];
-    uvs[5] = mesh.m_uvs[uv3 * 2 + 1];
+    vertices[6] = data.vertices[v3 * 3 + 0];
+    vertices[7] = data.vertices[v3 * 3 + 1];
+    vertices[8] = data.vertices[v3 * 3 + 2];
+    normals[6] = data.normals[n1 * 3 + 0];
+    normals[7] = data.normals[n1 * 3 + 1];
+    normals[8] = data.normals[n1 * 3 + 2];
+    uvs[4] = data.uvs[uv3 * 2 + 0];
+    uvs[5] = data.uvs[uv3 * 2 + 1];
 }
\ No newline at end of file
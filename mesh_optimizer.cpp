@@ -0,0 +1,505 @@
+#include "mesh_optimizer.h"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+constexpr int k_cache_size = 16;
+constexpr int k_overdraw_grid_size = 256;
+
+struct MeshTriangles
+{
+    std::vector<uint32_t> vertex_indices;
+    std::vector<uint32_t> uv_indices;
+    std::vector<uint32_t> normal_indices;
+};
+
+static MeshTriangles ReadTriangles(const MyMesh& mesh)
+{
+    MeshTriangles triangles;
+    VisitIndexType(mesh, [&](auto index){
+        using Index = decltype(index);
+        const auto vertex_indices = mesh.vertex_indices<Index>();
+        const auto uv_indices = mesh.uv_indices<Index>();
+        const auto normal_indices = mesh.normal_indices<Index>();
+        triangles.vertex_indices.assign(vertex_indices.begin(), vertex_indices.end());
+        triangles.uv_indices.assign(uv_indices.begin(), uv_indices.end());
+        triangles.normal_indices.assign(normal_indices.begin(), normal_indices.end());
+    });
+
+    return triangles;
+}
+
+static float AnalyzeVertexCache(const std::vector<uint32_t>& indices, const int vertex_count)
+{
+    if(indices.empty())
+    {
+        return 0.0f;
+    }
+
+    // a vertex is still in the FIFO if fewer than k_cache_size misses happened since it was loaded
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t time = k_cache_size + 1;
+    int misses = 0;
+    for(const uint32_t index : indices)
+    {
+        if(time - timestamps[index] > k_cache_size)
+        {
+            timestamps[index] = time++;
+            ++misses;
+        }
+    }
+
+    return misses / (float)(indices.size() / 3);
+}
+
+static glm::vec3 GetPosition(const std::span<const float> positions, const uint32_t index)
+{
+    return {positions[index * 3 + 0], positions[index * 3 + 1], positions[index * 3 + 2]};
+}
+
+static float AnalyzeOverdraw(const MeshTriangles& triangles, const std::span<const float> positions, const std::span<const float> normals)
+{
+    if(triangles.vertex_indices.empty())
+    {
+        return 0.0f;
+    }
+
+    glm::vec3 min_position = GetPosition(positions, 0);
+    glm::vec3 max_position = min_position;
+    for(size_t i = 0; i < positions.size() / 3; ++i)
+    {
+        min_position = glm::min(min_position, GetPosition(positions, (uint32_t)i));
+        max_position = glm::max(max_position, GetPosition(positions, (uint32_t)i));
+    }
+
+    const glm::vec3 center = (min_position + max_position) * 0.5f;
+    const float radius = std::max(glm::length(max_position - center), 1e-6f);
+    const float to_grid = k_overdraw_grid_size / (2.0f * radius);
+
+    const glm::vec3 view_directions[] = {
+        {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+        {1, 1, 1}, {-1, 1, 1}, {1, -1, 1}, {1, 1, -1}, {-1, -1, 1}, {-1, 1, -1}, {1, -1, -1}, {-1, -1, -1}
+    };
+
+    std::vector<float> depth_buffer(k_overdraw_grid_size * k_overdraw_grid_size);
+    int64_t shaded_pixels = 0;
+    int64_t covered_pixels = 0;
+    for(const glm::vec3 view_direction : view_directions)
+    {
+        const glm::vec3 forward = glm::normalize(view_direction);
+        const glm::vec3 up_hint = std::abs(forward.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+        const glm::vec3 right = glm::normalize(glm::cross(up_hint, forward));
+        const glm::vec3 up = glm::cross(forward, right);
+        std::fill(depth_buffer.begin(), depth_buffer.end(), INFINITY);
+
+        for(size_t t = 0; t < triangles.vertex_indices.size() / 3; ++t)
+        {
+            // cull like the renderer does, with the face's first normal
+            const uint32_t n = triangles.normal_indices[t * 3];
+            const glm::vec3 normal{normals[n * 3 + 0], normals[n * 3 + 1], normals[n * 3 + 2]};
+            if(glm::dot(normal, forward) >= 0.0f)
+            {
+                continue;
+            }
+
+            glm::vec3 p[3];
+            for(int k = 0; k < 3; ++k)
+            {
+                const glm::vec3 position = GetPosition(positions, triangles.vertex_indices[t * 3 + k]) - center;
+                p[k] = {(glm::dot(position, right) + radius) * to_grid, (glm::dot(position, up) + radius) * to_grid, glm::dot(position, forward)};
+            }
+
+            const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+            if(area == 0.0f)
+            {
+                continue;
+            }
+
+            const int min_x = std::max(0, (int)std::floor(std::min({p[0].x, p[1].x, p[2].x})));
+            const int max_x = std::min(k_overdraw_grid_size - 1, (int)std::ceil(std::max({p[0].x, p[1].x, p[2].x})));
+            const int min_y = std::max(0, (int)std::floor(std::min({p[0].y, p[1].y, p[2].y})));
+            const int max_y = std::min(k_overdraw_grid_size - 1, (int)std::ceil(std::max({p[0].y, p[1].y, p[2].y})));
+            const float area_recip = 1.0f / area;
+            for(int y = min_y; y <= max_y; ++y)
+            {
+                for(int x = min_x; x <= max_x; ++x)
+                {
+                    const float px = x + 0.5f;
+                    const float py = y + 0.5f;
+                    const float w0 = ((p[2].x - p[1].x) * (py - p[1].y) - (p[2].y - p[1].y) * (px - p[1].x)) * area_recip;
+                    const float w1 = ((p[0].x - p[2].x) * (py - p[2].y) - (p[0].y - p[2].y) * (px - p[2].x)) * area_recip;
+                    const float w2 = 1.0f - w0 - w1;
+                    if(w0 < 0 || w1 < 0 || w2 < 0)
+                    {
+                        continue;
+                    }
+
+                    const float z = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+                    float& depth = depth_buffer[y * k_overdraw_grid_size + x];
+                    if(z < depth)
+                    {
+                        covered_pixels += depth == INFINITY ? 1 : 0;
+                        depth = z;
+                        ++shaded_pixels;
+                    }
+                }
+            }
+        }
+    }
+
+    return covered_pixels > 0 ? shaded_pixels / (float)covered_pixels : 0.0f;
+}
+
+static float ForsythVertexScore(const int cache_position, const int remaining_triangles)
+{
+    if(remaining_triangles == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if(cache_position >= 0)
+    {
+        // the last triangle's vertices get a fixed score so the next pick doesn't just reuse its edge
+        score = cache_position < 3 ? 0.75f : std::pow(1.0f - (cache_position - 3) / (float)(k_cache_size - 3), 1.5f);
+    }
+
+    // favour vertices with few triangles left so they leave the working set early
+    return score + 2.0f * std::pow((float)remaining_triangles, -0.5f);
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation, returns the new triangle order
+static std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, const int vertex_count)
+{
+    const size_t triangle_count = indices.size() / 3;
+
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for(const uint32_t index : indices)
+    {
+        ++adjacency_offsets[index + 1];
+    }
+
+    std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+    std::vector<uint32_t> remaining_triangles(vertex_count);
+    std::vector<uint32_t> adjacency(indices.size());
+    for(int v = 0; v < vertex_count; ++v)
+    {
+        remaining_triangles[v] = adjacency_offsets[v + 1] - adjacency_offsets[v];
+    }
+
+    {
+        std::vector<uint32_t> fill(vertex_count, 0);
+        for(size_t i = 0; i < indices.size(); ++i)
+        {
+            const uint32_t v = indices[i];
+            adjacency[adjacency_offsets[v] + fill[v]++] = (uint32_t)(i / 3);
+        }
+    }
+
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for(int v = 0; v < vertex_count; ++v)
+    {
+        vertex_scores[v] = ForsythVertexScore(-1, remaining_triangles[v]);
+    }
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    for(size_t t = 0; t < triangle_count; ++t)
+    {
+        triangle_scores[t] = vertex_scores[indices[t * 3 + 0]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(triangle_count);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> next_cache;
+    size_t dead_end_cursor = 0;
+    int64_t best_triangle = -1;
+    float best_score = -1.0f;
+    for(size_t t = 0; t < triangle_count; ++t)
+    {
+        if(triangle_scores[t] > best_score)
+        {
+            best_score = triangle_scores[t];
+            best_triangle = (int64_t)t;
+        }
+    }
+
+    while(best_triangle >= 0)
+    {
+        const uint32_t* corners = &indices[best_triangle * 3];
+        emitted[best_triangle] = true;
+        order.push_back((uint32_t)best_triangle);
+
+        // most recently used first, vertices pushed past the cache size fall out
+        next_cache.assign(corners, corners + 3);
+        for(const uint32_t v : cache)
+        {
+            if(v != corners[0] && v != corners[1] && v != corners[2])
+            {
+                next_cache.push_back(v);
+            }
+        }
+
+        for(int k = 0; k < 3; ++k)
+        {
+            const uint32_t v = corners[k];
+            uint32_t* begin = &adjacency[adjacency_offsets[v]];
+            uint32_t* end = begin + remaining_triangles[v];
+            std::iter_swap(std::find(begin, end, (uint32_t)best_triangle), end - 1);
+            --remaining_triangles[v];
+        }
+
+        for(size_t i = 0; i < next_cache.size(); ++i)
+        {
+            const uint32_t v = next_cache[i];
+            cache_positions[v] = i < (size_t)k_cache_size ? (int)i : -1;
+            vertex_scores[v] = ForsythVertexScore(cache_positions[v], remaining_triangles[v]);
+        }
+
+        next_cache.resize(std::min(next_cache.size(), (size_t)k_cache_size));
+        std::swap(cache, next_cache);
+
+        best_triangle = -1;
+        best_score = -1.0f;
+        for(const uint32_t v : cache)
+        {
+            for(uint32_t i = 0; i < remaining_triangles[v]; ++i)
+            {
+                const uint32_t t = adjacency[adjacency_offsets[v] + i];
+                triangle_scores[t] = vertex_scores[indices[t * 3 + 0]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+                if(triangle_scores[t] > best_score)
+                {
+                    best_score = triangle_scores[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        if(best_triangle < 0)
+        {
+            // nothing left next to the cache, continue with the next triangle in the original order
+            while(dead_end_cursor < triangle_count && emitted[dead_end_cursor])
+            {
+                ++dead_end_cursor;
+            }
+
+            best_triangle = dead_end_cursor < triangle_count ? (int64_t)dead_end_cursor : -1;
+        }
+    }
+
+    return order;
+}
+
+// Splits the cache optimized order into clusters and draws the clusters facing away from the mesh
+// center first, so they occlude the rest (Sander et al., Tipsify; the clustering follows meshoptimizer)
+static std::vector<uint32_t> OptimizeOverdraw(const MeshTriangles& triangles, const std::vector<uint32_t>& order, const std::span<const float> positions, const std::span<const float> normals, const int vertex_count)
+{
+    // how much worse than the cache optimized order a cluster's ACMR is allowed to get
+    constexpr float acmr_threshold = 1.05f;
+
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t time = k_cache_size + 1;
+    const auto CountMisses = [&](const uint32_t t){
+        int misses = 0;
+        for(int k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangles.vertex_indices[t * 3 + k];
+            if(time - timestamps[v] > k_cache_size)
+            {
+                timestamps[v] = time++;
+                ++misses;
+            }
+        }
+
+        return misses;
+    };
+
+    // hard boundaries where the cache restarts anyway
+    std::vector<size_t> hard_boundaries;
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        if(CountMisses(order[i]) == 3 || i == 0)
+        {
+            hard_boundaries.push_back(i);
+        }
+    }
+
+    hard_boundaries.push_back(order.size());
+
+    // soft boundaries split those further wherever the cluster so far is already within the threshold
+    std::vector<size_t> cluster_starts;
+    for(size_t h = 0; h + 1 < hard_boundaries.size(); ++h)
+    {
+        const size_t start = hard_boundaries[h];
+        const size_t end = hard_boundaries[h + 1];
+
+        time += k_cache_size + 1;
+        int cluster_misses = 0;
+        for(size_t i = start; i < end; ++i)
+        {
+            cluster_misses += CountMisses(order[i]);
+        }
+
+        const float cluster_threshold = acmr_threshold * cluster_misses / (float)(end - start);
+        cluster_starts.push_back(start);
+        time += k_cache_size + 1;
+        int running_misses = 0;
+        int running_triangles = 0;
+        for(size_t i = start; i + 1 < end; ++i)
+        {
+            running_misses += CountMisses(order[i]);
+            ++running_triangles;
+            if(running_misses / (float)running_triangles <= cluster_threshold)
+            {
+                cluster_starts.push_back(i + 1);
+                time += k_cache_size + 1;
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+    }
+
+    cluster_starts.push_back(order.size());
+
+    glm::vec3 mesh_centroid{0.0f};
+    float mesh_area = 0.0f;
+    std::vector<glm::vec3> cluster_centroids(cluster_starts.size() - 1);
+    std::vector<glm::vec3> cluster_normals(cluster_starts.size() - 1);
+    for(size_t c = 0; c + 1 < cluster_starts.size(); ++c)
+    {
+        glm::vec3 centroid{0.0f};
+        glm::vec3 normal{0.0f};
+        float cluster_area = 0.0f;
+        for(size_t i = cluster_starts[c]; i < cluster_starts[c + 1]; ++i)
+        {
+            const uint32_t t = order[i];
+            const glm::vec3 a = GetPosition(positions, triangles.vertex_indices[t * 3 + 0]);
+            const glm::vec3 b = GetPosition(positions, triangles.vertex_indices[t * 3 + 1]);
+            const glm::vec3 c3 = GetPosition(positions, triangles.vertex_indices[t * 3 + 2]);
+            const float area = glm::length(glm::cross(b - a, c3 - a)) * 0.5f;
+            const uint32_t n = triangles.normal_indices[t * 3];
+            centroid += (a + b + c3) * (area / 3.0f);
+            normal += glm::vec3(normals[n * 3 + 0], normals[n * 3 + 1], normals[n * 3 + 2]) * area;
+            cluster_area += area;
+        }
+
+        mesh_centroid += centroid;
+        mesh_area += cluster_area;
+        cluster_centroids[c] = cluster_area > 0.0f ? centroid / cluster_area : centroid;
+        cluster_normals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+    }
+
+    mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : mesh_centroid;
+
+    std::vector<float> sort_keys(cluster_centroids.size());
+    for(size_t c = 0; c < sort_keys.size(); ++c)
+    {
+        sort_keys[c] = glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c]);
+    }
+
+    std::vector<size_t> cluster_order(sort_keys.size());
+    std::iota(cluster_order.begin(), cluster_order.end(), 0);
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](const size_t a, const size_t b){
+        return sort_keys[a] > sort_keys[b];
+    });
+
+    std::vector<uint32_t> new_order;
+    new_order.reserve(order.size());
+    for(const size_t c : cluster_order)
+    {
+        new_order.insert(new_order.end(), order.begin() + cluster_starts[c], order.begin() + cluster_starts[c + 1]);
+    }
+
+    return new_order;
+}
+
+// Renumbers one attribute stream in the order the indices first touch it, unused entries go last
+static void OptimizeVertexFetch(std::vector<uint32_t>& indices, const std::span<const float> source, const int components, const std::span<float> destination)
+{
+    const size_t count = source.size() / components;
+    std::vector<uint32_t> remap(count, UINT32_MAX);
+    uint32_t next = 0;
+    for(uint32_t& index : indices)
+    {
+        if(remap[index] == UINT32_MAX)
+        {
+            remap[index] = next++;
+        }
+
+        index = remap[index];
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(remap[i] == UINT32_MAX)
+        {
+            remap[i] = next++;
+        }
+
+        std::copy_n(&source[i * components], components, &destination[remap[i] * components]);
+    }
+}
+
+MeshStatistics AnalyzeMesh(const MyMesh& mesh)
+{
+    if(mesh.vertex_format() != VertexFormat::Float)
+    {
+        return {0.0f, 0.0f};
+    }
+
+    const MeshTriangles triangles = ReadTriangles(mesh);
+    return {
+        AnalyzeVertexCache(triangles.vertex_indices, mesh.vertex_count()),
+        AnalyzeOverdraw(triangles, mesh.vertices(), mesh.normals())
+    };
+}
+
+MyMesh OptimizeMesh(const MyMesh& mesh)
+{
+    if(mesh.vertex_format() != VertexFormat::Float || mesh.triangle_count() == 0)
+    {
+        return mesh;
+    }
+
+    const MeshTriangles triangles = ReadTriangles(mesh);
+    const MeshStatistics before = {
+        AnalyzeVertexCache(triangles.vertex_indices, mesh.vertex_count()),
+        AnalyzeOverdraw(triangles, mesh.vertices(), mesh.normals())
+    };
+
+    std::vector<uint32_t> order = OptimizeVertexCache(triangles.vertex_indices, mesh.vertex_count());
+    order = OptimizeOverdraw(triangles, order, mesh.vertices(), mesh.normals(), mesh.vertex_count());
+
+    MeshTriangles reordered;
+    for(const uint32_t t : order)
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            reordered.vertex_indices.push_back(triangles.vertex_indices[t * 3 + k]);
+            reordered.uv_indices.push_back(triangles.uv_indices[t * 3 + k]);
+            reordered.normal_indices.push_back(triangles.normal_indices[t * 3 + k]);
+        }
+    }
+
+    MyMesh optimized{mesh.vertex_count(), mesh.normal_count(), mesh.uv_count(), mesh.triangle_count()};
+    auto& data = *optimized.m_data;
+    OptimizeVertexFetch(reordered.vertex_indices, mesh.vertices(), 3, data.vertices);
+    OptimizeVertexFetch(reordered.uv_indices, mesh.uvs(), 2, data.uvs);
+    OptimizeVertexFetch(reordered.normal_indices, mesh.normals(), 3, data.normals);
+    for(size_t i = 0; i < reordered.vertex_indices.size(); ++i)
+    {
+        MyMesh::StoreIndex(data.vertex_indices, data.index_size, i, reordered.vertex_indices[i]);
+        MyMesh::StoreIndex(data.uv_indices, data.index_size, i, reordered.uv_indices[i]);
+        MyMesh::StoreIndex(data.normal_indices, data.index_size, i, reordered.normal_indices[i]);
+    }
+
+    const MeshStatistics after = AnalyzeMesh(optimized);
+    Log("Mesh optimization: ACMR %0.3f -> %0.3f, overdraw %0.3f -> %0.3f", before.acmr, after.acmr, before.overdraw, after.overdraw);
+    return optimized;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mesh.h"
+
+struct MeshStatistics
+{
+    float acmr;     // average post-transform cache misses per triangle, 16 entry FIFO keyed on positions
+    float overdraw; // fragments passing the depth test per covered pixel, averaged over several views
+};
+
+// Reorders triangles for the post-transform vertex cache (Forsyth), then reorders clusters of those
+// triangles so outward facing ones draw first, then lays the attribute arrays out in first use order.
+// Only float meshes are optimized, run it before CompressMesh.
+MyMesh OptimizeMesh(const MyMesh& mesh);
+
+MeshStatistics AnalyzeMesh(const MyMesh& mesh);
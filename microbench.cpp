@@ -0,0 +1,533 @@
+#include "log.h"
+#include "mesh.h"
+#include "renderer.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Google Benchmark timings of the pipeline kernels on synthetic inputs, one level below the frame
+// numbers Demo3dBench reports. Every benchmark reports ns_per_op and bytes_per_op next to the
+// per iteration time, an op is whatever the kernel handles one of: a triangle, a vertex or a pixel.
+
+constexpr glm::ivec2 k_viewport_size{512, 512};
+constexpr int k_atlas_size = 256;
+constexpr int k_sample_count = 4096;
+// larger than the caches close to the core so the texture layouts make a difference
+constexpr int k_layout_texture_size = 1024;
+// pixel rows as long as the texture, down a column a row of a row major texture misses every pixel
+constexpr glm::ivec2 k_rotated_patch_size{1024, 128};
+// a 32 KB level 1 data cache of 64 byte lines
+constexpr size_t k_simulated_cache_lines = 512;
+
+MyTexture g_layout_textures[4];
+
+void SetOpCounters(benchmark::State& state, const int64_t ops_per_iteration, const double bytes_per_op)
+{
+    const int64_t ops = state.iterations() * ops_per_iteration;
+    state.SetItemsProcessed(ops);
+    state.SetBytesProcessed((int64_t)(ops * bytes_per_op));
+    // a rate over nanoseconds, inverted into nanoseconds per op
+    state.counters["ns_per_op"] = benchmark::Counter(ops * 1e-9, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["bytes_per_op"] = bytes_per_op;
+}
+
+std::filesystem::path WriteGridObjFile(const int cells)
+{
+    // a flat grid of cells x cells quads, two triangles each, with a uv per vertex and a single normal
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / ("demo3d_microbench_grid_" + std::to_string(cells) + ".obj");
+    std::FILE* file = std::fopen(path.string().c_str(), "w");
+    if(!file)
+    {
+        return path;
+    }
+
+    std::fprintf(file, "o Grid\n");
+    for(int y = 0; y <= cells; ++y)
+    {
+        for(int x = 0; x <= cells; ++x)
+        {
+            std::fprintf(file, "v %f %f 0.000000\n", (ftype)x / cells * 2.0f - 1.0f, (ftype)y / cells * 2.0f - 1.0f);
+        }
+    }
+
+    for(int y = 0; y <= cells; ++y)
+    {
+        for(int x = 0; x <= cells; ++x)
+        {
+            std::fprintf(file, "vt %f %f\n", (ftype)x / cells, (ftype)y / cells);
+        }
+    }
+
+    std::fprintf(file, "vn 0.0000 0.0000 1.0000\n");
+    for(int y = 0; y < cells; ++y)
+    {
+        for(int x = 0; x < cells; ++x)
+        {
+            const int a = y * (cells + 1) + x + 1;
+            const int b = a + 1;
+            const int c = a + cells + 1;
+            const int d = c + 1;
+            std::fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, d, d);
+            std::fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, d, d, c, c);
+        }
+    }
+
+    std::fclose(file);
+    return path;
+}
+
+Viewport CreateViewport(const FramebufferLayout layout = FramebufferLayout::Linear)
+{
+    const FramebufferLayout previous_layout = g_framebuffer_layout;
+    g_framebuffer_layout = layout;
+    Viewport viewport{};
+    InitializeCamera(viewport, {0, 0, k_viewport_size.x, k_viewport_size.y}, 20.0f, 0.0f);
+    g_framebuffer_layout = previous_layout;
+    return viewport;
+}
+
+void DestroyViewport(Viewport& viewport)
+{
+    UnloadImage(viewport.z_buffer);
+    UnloadImage(viewport.color_buffer);
+}
+
+std::vector<glm::vec2> GenerateUvs(const int pattern)
+{
+    // 0 walks along rows of the atlas, 1 down its columns, 2 jumps around at random
+    std::vector<glm::vec2> uvs(k_sample_count);
+    std::mt19937 random{1234};
+    std::uniform_real_distribution<ftype> distribution{0.0f, 1.0f};
+    for(int i = 0; i < k_sample_count; ++i)
+    {
+        const ftype along = (ftype)(i % k_atlas_size) / k_atlas_size;
+        const ftype across = (ftype)(i / k_atlas_size) / k_atlas_size;
+        uvs[i] = pattern == 0 ? glm::vec2{along, across}
+            : pattern == 1 ? glm::vec2{across, along}
+            : glm::vec2{distribution(random), distribution(random)};
+    }
+
+    return uvs;
+}
+
+std::vector<glm::ivec2> GeneratePixels(const bool is_random)
+{
+    std::vector<glm::ivec2> pixels(k_sample_count);
+    std::mt19937 random{1234};
+    for(int i = 0; i < k_sample_count; ++i)
+    {
+        pixels[i] = is_random
+            ? glm::ivec2{(int)(random() % k_viewport_size.x), (int)(random() % k_viewport_size.y)}
+            : glm::ivec2{i % k_viewport_size.x, i / k_viewport_size.x};
+    }
+
+    return pixels;
+}
+
+void BM_ParseObjFile(benchmark::State& state)
+{
+    const int cells = (int)state.range(0);
+    const std::filesystem::path path = WriteGridObjFile(cells);
+    const size_t file_size = std::filesystem::file_size(path);
+    int triangle_count = 0;
+    for(auto _ : state)
+    {
+        const MyMesh mesh = ParseObjFile(path);
+        triangle_count = mesh.triangle_count();
+        benchmark::DoNotOptimize(mesh.vertices().data());
+    }
+
+    SetOpCounters(state, triangle_count, (double)file_size / triangle_count);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ParseObjFile)->Arg(8)->Arg(32)->Arg(128)->Unit(benchmark::kMillisecond);
+
+void BM_GetMeshTriangle(benchmark::State& state)
+{
+    const std::filesystem::path path = WriteGridObjFile(128);
+    const MyMesh mesh = CompressMesh(ParseObjFile(path), (VertexFormat)state.range(0));
+    std::filesystem::remove(path);
+
+    for(auto _ : state)
+    {
+        VisitIndexType(mesh, [&](auto index){
+            using Index = decltype(index);
+            float vertices[9], uvs[6], normals[9];
+            for(int i = 0; i < mesh.triangle_count(); ++i)
+            {
+                GetMeshTriangle<Index>(mesh, i, vertices, uvs, normals);
+                benchmark::DoNotOptimize(vertices);
+                benchmark::DoNotOptimize(uvs);
+                benchmark::DoNotOptimize(normals);
+            }
+        });
+    }
+
+    // everything the mesh stores, spread over its triangles
+    SetOpCounters(state, mesh.triangle_count(), (double)mesh.memory_size() / mesh.triangle_count());
+}
+BENCHMARK(BM_GetMeshTriangle)
+    ->Arg((int)VertexFormat::Float)
+    ->Arg((int)VertexFormat::Compressed)
+    ->Arg((int)VertexFormat::CompressedOct8);
+
+void BM_TransformToScreen(benchmark::State& state)
+{
+    std::vector<glm::vec3> positions(k_sample_count);
+    std::mt19937 random{1234};
+    std::uniform_real_distribution<ftype> distribution{-1.0f, 1.0f};
+    for(glm::vec3& position : positions)
+    {
+        position = {distribution(random), distribution(random), distribution(random)};
+    }
+
+    Viewport viewport = CreateViewport();
+    const glm::mat4 object_to_screen = viewport.camera.worldToScreenSpace;
+    for(auto _ : state)
+    {
+        for(const glm::vec3& position : positions)
+        {
+            glm::vec4 screen = TransformToScreen(object_to_screen, position);
+            benchmark::DoNotOptimize(screen);
+        }
+    }
+
+    SetOpCounters(state, k_sample_count, sizeof(glm::vec3) + sizeof(glm::vec4));
+    DestroyViewport(viewport);
+}
+BENCHMARK(BM_TransformToScreen);
+
+void BM_DrawTriangle(benchmark::State& state)
+{
+    // right triangles with legs of the given length in pixels tiled over the viewport. Tiny ones
+    // measure the setup, big ones the per pixel raster and shade loop
+    const int size = (int)state.range(0);
+    const FramebufferLayout layout = (FramebufferLayout)state.range(1);
+    const int columns = k_viewport_size.x / size;
+    const int rows = k_viewport_size.y / size;
+    const int triangle_count = std::min(columns * rows, 1024);
+    Viewport viewport = CreateViewport(layout);
+    const glm::vec2 uv[3] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}};
+    for(auto _ : state)
+    {
+        for(int i = 0; i < triangle_count; ++i)
+        {
+            // depth 0 everywhere, equal depths pass the test so every pass shades every pixel
+            const glm::vec3 corner{(ftype)(i % columns * size), (ftype)(i / columns % rows * size), 0.0f};
+            const Vertex a{corner, {0, 0, 1}, uv[0]};
+            const Vertex b{corner + glm::vec3(size, 0, 0), {0, 0, 1}, uv[1]};
+            const Vertex c{corner + glm::vec3(0, size, 0), {0, 0, 1}, uv[2]};
+            DrawTriangle(viewport, a, b, c, nullptr, {1, 1, 1, 1}, false);
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    // the pixels covered per triangle, roughly, the edge rules decide the exact count
+    const double pixels_per_triangle = 0.5 * size * size;
+    SetOpCounters(state, triangle_count, pixels_per_triangle * 4 * sizeof(Color));
+    state.counters["pixels_per_op"] = pixels_per_triangle;
+    DestroyViewport(viewport);
+}
+BENCHMARK(BM_DrawTriangle)
+    ->ArgNames({"size", "framebuffer"})
+    ->ArgsProduct({{1, 4, 16, 64, 256}, {(int)FramebufferLayout::Linear, (int)FramebufferLayout::Tiled8x8, (int)FramebufferLayout::Tiled16x16}});
+
+void BM_DrawTextureSampledPixel(benchmark::State& state)
+{
+    // sampled as if every pixel covered 4x4 texels, the filters with mips read from level 2
+    constexpr ftype lod = 2.0f;
+    const std::vector<glm::vec2> uvs = GenerateUvs((int)state.range(0));
+    const std::vector<glm::ivec2> pixels = GeneratePixels(false);
+    const TextureFilter previous_filter = g_texture_filter;
+    g_texture_filter = (TextureFilter)state.range(1);
+    Viewport viewport = CreateViewport();
+    for(auto _ : state)
+    {
+        for(int i = 0; i < k_sample_count; ++i)
+        {
+            DrawTextureSampledPixel(viewport, pixels[i].x, pixels[i].y, 0.0f, uvs[i], lod, TextureRegion{}, {1, 1, 1, 1});
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    // texels, depth read, depth write and color write
+    SetOpCounters(state, k_sample_count, (GetTexelsPerSample(g_texture_filter) + 3) * sizeof(Color));
+    DestroyViewport(viewport);
+    g_texture_filter = previous_filter;
+}
+BENCHMARK(BM_DrawTextureSampledPixel)
+    ->ArgNames({"pattern", "filter"})
+    ->ArgsProduct({{0, 1, 2}, {(int)TextureFilter::Nearest, (int)TextureFilter::NearestMip, (int)TextureFilter::Bilinear, (int)TextureFilter::Trilinear}});
+
+void BM_SampleTexture(benchmark::State& state)
+{
+    // 0 nearest mip one pixel at a time, 1 bilinear one pixel at a time, 2 bilinear through the batch kernel
+    const int kernel = (int)state.range(1);
+    const std::vector<glm::vec2> uvs = GenerateUvs((int)state.range(0));
+    const std::vector<ftype> lods(k_sample_count, 2.0f);
+    std::vector<Color> colors(k_sample_count);
+    for(auto _ : state)
+    {
+        if(kernel == 2)
+        {
+            SampleBilinearBatch(g_sprite_atlas, uvs.data(), lods.data(), k_sample_count, TextureRegion{}, colors.data());
+            benchmark::DoNotOptimize(colors.data());
+        }
+        else
+        {
+            const TextureFilter filter = kernel == 0 ? TextureFilter::NearestMip : TextureFilter::Bilinear;
+            glm::vec4 sum{0.0f};
+            for(int i = 0; i < k_sample_count; ++i)
+            {
+                sum += SampleTexture(g_sprite_atlas, uvs[i], lods[i], filter);
+            }
+
+            benchmark::DoNotOptimize(sum);
+        }
+    }
+
+    SetOpCounters(state, k_sample_count, (kernel == 0 ? 1 : 4) * sizeof(Color));
+}
+BENCHMARK(BM_SampleTexture)->ArgNames({"pattern", "kernel"})->ArgsProduct({{0, 2}, {0, 1, 2}});
+
+template<TextureLayout layout>
+void BM_SampleRotatedUv(benchmark::State& state)
+{
+    // a screen aligned patch of pixels mapped one texel per pixel onto the texture, rotated in uv space.
+    // At 0 degrees pixel rows walk texel rows, at 90 they walk texel columns
+    const MyTexture& texture = g_layout_textures[(int)layout];
+    const ftype angle = glm::radians((ftype)state.range(0));
+    const glm::vec2 step_x = glm::vec2(std::cos(angle), std::sin(angle)) / (ftype)k_layout_texture_size;
+    const glm::vec2 step_y = glm::vec2(-std::sin(angle), std::cos(angle)) / (ftype)k_layout_texture_size;
+    std::vector<glm::vec2> uvs;
+    uvs.reserve(k_rotated_patch_size.x * k_rotated_patch_size.y);
+    for(int y = 0; y < k_rotated_patch_size.y; ++y)
+    {
+        for(int x = 0; x < k_rotated_patch_size.x; ++x)
+        {
+            uvs.push_back(glm::vec2(0.5f, 0.5f) + step_x * (ftype)x + step_y * (ftype)y);
+        }
+    }
+
+    for(auto _ : state)
+    {
+        glm::vec4 sum{0.0f};
+        for(const glm::vec2 uv : uvs)
+        {
+            sum += SampleTexture<layout>(texture, uv, 0.0f, TextureFilter::Nearest, TextureRegion{});
+        }
+
+        benchmark::DoNotOptimize(sum);
+    }
+
+    // misses of the same walk through a fully associative LRU cache, the same on every machine.
+    // Hardware counts come from --benchmark_perf_counters=CYCLES,CACHE-MISSES when the library has libpfm
+    std::list<size_t> recent_lines;
+    std::unordered_map<size_t, std::list<size_t>::iterator> cached_lines;
+    int64_t miss_count = 0;
+    const MipLevel& level = texture.level(0);
+    for(const glm::vec2 uv : uvs)
+    {
+        const glm::vec2 wrapped_uv = glm::fract(uv);
+        const int u = std::min((int)glm::floor(wrapped_uv.x * level.width), level.width - 1);
+        const int v = std::min((int)glm::floor(wrapped_uv.y * level.height), level.height - 1);
+        const size_t texel = GetTexelIndex<layout>(level, u, v);
+        const size_t line = (layout == TextureLayout::Bc1 ? texel / 16 * sizeof(uint64_t) : texel * sizeof(Color)) / 64;
+        const auto cached = cached_lines.find(line);
+        if(cached != cached_lines.end())
+        {
+            recent_lines.splice(recent_lines.begin(), recent_lines, cached->second);
+            continue;
+        }
+
+        ++miss_count;
+        recent_lines.push_front(line);
+        cached_lines[line] = recent_lines.begin();
+        if(recent_lines.size() > k_simulated_cache_lines)
+        {
+            cached_lines.erase(recent_lines.back());
+            recent_lines.pop_back();
+        }
+    }
+
+    SetOpCounters(state, (int64_t)uvs.size(), sizeof(Color));
+    state.counters["simulated_misses_per_op"] = (double)miss_count / uvs.size();
+}
+BENCHMARK(BM_SampleRotatedUv<TextureLayout::Linear>)->ArgName("degrees")->Arg(0)->Arg(30)->Arg(45)->Arg(90);
+BENCHMARK(BM_SampleRotatedUv<TextureLayout::Blocked4x4>)->ArgName("degrees")->Arg(0)->Arg(30)->Arg(45)->Arg(90);
+BENCHMARK(BM_SampleRotatedUv<TextureLayout::Morton>)->ArgName("degrees")->Arg(0)->Arg(30)->Arg(45)->Arg(90);
+BENCHMARK(BM_SampleRotatedUv<TextureLayout::Bc1>)->ArgName("degrees")->Arg(0)->Arg(30)->Arg(45)->Arg(90);
+
+void BM_DrawPixel(benchmark::State& state)
+{
+    // occluded pixels stop after the depth read, the rest write depth and color
+    const bool is_random = state.range(0) != 0;
+    const bool is_occluded = state.range(1) != 0;
+    const std::vector<glm::ivec2> pixels = GeneratePixels(is_random);
+    Viewport viewport = CreateViewport();
+    if(is_occluded)
+    {
+        ClearFramebuffer(viewport.framebuffer, BLACK, BLACK);
+    }
+
+    const ftype z = is_occluded ? 1.0f : -1.0f;
+    for(auto _ : state)
+    {
+        for(const glm::ivec2& pixel : pixels)
+        {
+            DrawPixel(viewport, pixel.x, pixel.y, z, {1, 0, 1, 1});
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    SetOpCounters(state, k_sample_count, (is_occluded ? 1 : 3) * sizeof(Color));
+    DestroyViewport(viewport);
+}
+BENCHMARK(BM_DrawPixel)->ArgNames({"random", "occluded"})->ArgsProduct({{0, 1}, {0, 1}});
+
+void BM_ResolveFramebuffer(benchmark::State& state)
+{
+    // detiling color and depth into the images, once per frame for tiled framebuffers. Every tile
+    // was drawn into, so all of them get copied
+    Viewport viewport = CreateViewport((FramebufferLayout)state.range(0));
+    for(int y = 0; y < k_viewport_size.y; ++y)
+    {
+        for(int x = 0; x < k_viewport_size.x; ++x)
+        {
+            DrawPixel(viewport, x, y, 0.0f, {1, 0, 1, 1});
+        }
+    }
+
+    for(auto _ : state)
+    {
+        ResolveFramebuffer(viewport.framebuffer);
+        benchmark::ClobberMemory();
+    }
+
+    // read and written, color and depth
+    SetOpCounters(state, k_viewport_size.x * k_viewport_size.y, 4 * sizeof(Color));
+    DestroyViewport(viewport);
+}
+BENCHMARK(BM_ResolveFramebuffer)->ArgName("framebuffer")->Arg((int)FramebufferLayout::Tiled8x8)->Arg((int)FramebufferLayout::Tiled16x16);
+
+void BM_ClearFramebuffer(benchmark::State& state)
+{
+    // a frame's clear and resolve around a square drawn over the given percentage of the screen,
+    // the tiles it covers get cleared on the first write and the rest only once it moved away
+    const FramebufferLayout layout = (FramebufferLayout)state.range(0);
+    const int covered_size = (int)(k_viewport_size.x * std::sqrt(state.range(1) / 100.0));
+    Viewport viewport = CreateViewport(layout);
+    for(auto _ : state)
+    {
+        ClearFramebuffer(viewport.framebuffer, BLACK, WHITE);
+        // once per tile of the smallest size, what drawing into them costs is not part of it
+        for(int y = 0; y < covered_size; y += 8)
+        {
+            for(int x = 0; x < covered_size; x += 8)
+            {
+                TouchTile(viewport.framebuffer, x, y);
+            }
+        }
+
+        ResolveFramebuffer(viewport.framebuffer);
+        benchmark::ClobberMemory();
+    }
+
+    // color and depth of the whole screen, which is what clearing used to write
+    SetOpCounters(state, k_viewport_size.x * k_viewport_size.y, 2 * sizeof(Color));
+    DestroyViewport(viewport);
+}
+BENCHMARK(BM_ClearFramebuffer)
+    ->ArgNames({"framebuffer", "covered_percent"})
+    ->ArgsProduct({{(int)FramebufferLayout::Linear, (int)FramebufferLayout::Tiled8x8, (int)FramebufferLayout::Tiled16x16}, {0, 10, 50, 100}});
+
+void BM_ConvertColor(benchmark::State& state)
+{
+    // 0 raylib's ColorNormalize and ColorFromNormalized, 1 the lookup table and the saturating SIMD pack
+    const bool is_packed = state.range(0) != 0;
+    std::vector<Color> colors(k_sample_count);
+    for(int i = 0; i < k_sample_count; ++i)
+    {
+        colors[i] = {(unsigned char)i, (unsigned char)(i >> 4), (unsigned char)(i * 7), 255};
+    }
+
+    const glm::vec4 light{0.9f, 0.8f, 0.7f, 1.0f};
+    for(auto _ : state)
+    {
+        for(Color& color : colors)
+        {
+            if(is_packed)
+            {
+                color = PackColor(ModulateColor(NormalizeColor(color), light));
+            }
+            else
+            {
+                const Vector4 normalized = ColorNormalize(color);
+                color = ColorFromNormalized({normalized.x * light.x, normalized.y * light.y, normalized.z * light.z, normalized.w});
+            }
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    SetOpCounters(state, k_sample_count, 2 * sizeof(Color));
+}
+BENCHMARK(BM_ConvertColor)->ArgName("packed")->Arg(0)->Arg(1);
+
+int main(int argc, char** argv)
+{
+    g_is_headless = true;
+    SetTraceLogLevel(LOG_WARNING);
+    SetLogLevel(LogLevel::Warning);
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // a generated atlas so the texture kernels don't depend on the assets
+    Image atlas = GenImageColor(k_atlas_size, k_atlas_size, WHITE);
+    Color* texels = (Color*)atlas.data;
+    for(int i = 0; i < k_atlas_size * k_atlas_size; ++i)
+    {
+        texels[i] = {(unsigned char)i, (unsigned char)(i >> 8), (unsigned char)(i * 7), 255};
+    }
+
+    g_sprite_atlas = MyTexture{atlas};
+    UnloadImage(atlas);
+
+    Image layout_image = GenImageColor(k_layout_texture_size, k_layout_texture_size, WHITE);
+    texels = (Color*)layout_image.data;
+    for(int i = 0; i < k_layout_texture_size * k_layout_texture_size; ++i)
+    {
+        texels[i] = {(unsigned char)i, (unsigned char)(i >> 8), (unsigned char)(i >> 16), 255};
+    }
+
+    for(const TextureLayout layout : {TextureLayout::Linear, TextureLayout::Blocked4x4, TextureLayout::Morton, TextureLayout::Bc1})
+    {
+        g_layout_textures[(int)layout] = MyTexture{layout_image, layout};
+    }
+
+    UnloadImage(layout_image);
+
+    g_main_light.direction = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+    g_main_light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    g_main_light.intensity = 1.0f;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+#include "profiler.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent
+{
+    const char* name;
+    int64_t start_nanoseconds;
+    int64_t end_nanoseconds;
+};
+
+// Written only by its own thread, the write count is published with release so a reader on another
+// thread can copy the events behind it without taking a lock
+struct TraceBuffer
+{
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> write_count = 0;
+    int thread_index;
+    std::string thread_name;
+};
+
+// a frame of Suzanne at 800x600 is around 2.5k events, this keeps the last couple hundred frames
+constexpr uint64_t k_trace_capacity = 1 << 19;
+
+ProfileFrame g_profile_frames[k_profile_history] = {};
+int g_profile_frame_index = 0;
+int g_profiled_frame_count = 0;
+std::atomic<bool> g_is_trace_capture_armed = false;
+// -1 when nothing is armed for the next frame, 0 records until disarmed
+int g_trace_capture_requested_frames = -1;
+int g_trace_capture_frames_left = 0;
+bool g_has_trace_capture_finished = false;
+std::mutex g_trace_buffers_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> g_trace_buffers;
+thread_local TraceBuffer* t_trace_buffer = nullptr;
+
+TraceBuffer& GetThreadTraceBuffer()
+{
+    if(t_trace_buffer)
+    {
+        return *t_trace_buffer;
+    }
+
+    // only taken the first time a thread records something, buffers live until the process exits
+    std::lock_guard lock{g_trace_buffers_mutex};
+    auto buffer = std::make_unique<TraceBuffer>();
+    buffer->events = std::make_unique<TraceEvent[]>(k_trace_capacity);
+    buffer->thread_index = (int)g_trace_buffers.size();
+    buffer->thread_name = "Thread " + std::to_string(buffer->thread_index);
+    t_trace_buffer = buffer.get();
+    g_trace_buffers.push_back(std::move(buffer));
+    return *t_trace_buffer;
+}
+
+void BeginProfileFrame()
+{
+    // captures line up with whole frames, whenever they got armed
+    g_has_trace_capture_finished = false;
+    if(g_trace_capture_requested_frames >= 0)
+    {
+        g_trace_capture_frames_left = g_trace_capture_requested_frames;
+        g_trace_capture_requested_frames = -1;
+        g_is_trace_capture_armed.store(true, std::memory_order_relaxed);
+    }
+
+    g_profile_frames[g_profile_frame_index] = {};
+    g_profile_frames[g_profile_frame_index].start_nanoseconds = GetProfileTimestamp();
+}
+
+void EndProfileFrame()
+{
+    ProfileFrame& frame = g_profile_frames[g_profile_frame_index];
+    const int64_t end = GetProfileTimestamp();
+    frame.frame_nanoseconds = end - frame.start_nanoseconds;
+    if(IsTraceCaptureArmed())
+    {
+        RecordTraceEvent("Frame", frame.start_nanoseconds, end);
+        if(g_trace_capture_frames_left > 0 && --g_trace_capture_frames_left == 0)
+        {
+            g_is_trace_capture_armed.store(false, std::memory_order_relaxed);
+            g_has_trace_capture_finished = true;
+        }
+    }
+
+    g_profile_frame_index = (g_profile_frame_index + 1) % k_profile_history;
+    g_profiled_frame_count = std::min(g_profiled_frame_count + 1, k_profile_history);
+}
+
+const ProfileFrame& GetProfileFrame(const int frames_ago)
+{
+    return g_profile_frames[(g_profile_frame_index - 1 - frames_ago + 2 * k_profile_history) % k_profile_history];
+}
+
+int GetProfiledFrameCount()
+{
+    return g_profiled_frame_count;
+}
+
+ProfileAverages GetProfileAverages()
+{
+    ProfileAverages averages = {};
+    if(g_profiled_frame_count == 0)
+    {
+        return averages;
+    }
+
+    for(int i = 0; i < g_profiled_frame_count; ++i)
+    {
+        const ProfileFrame& frame = GetProfileFrame(i);
+        for(int stage = 0; stage < k_profile_stage_count; ++stage)
+        {
+            averages.stage_milliseconds[stage] += frame.stage_nanoseconds[stage];
+        }
+
+        averages.frame_milliseconds += frame.frame_nanoseconds;
+    }
+
+    const double to_average_milliseconds = 1.0 / (1000000.0 * g_profiled_frame_count);
+    for(int stage = 0; stage < k_profile_stage_count; ++stage)
+    {
+        averages.stage_milliseconds[stage] *= to_average_milliseconds;
+    }
+
+    averages.frame_milliseconds *= to_average_milliseconds;
+    return averages;
+}
+
+const char* GetProfileStageName(const ProfileStage stage)
+{
+    switch(stage)
+    {
+        case ProfileStage::Clear: return "Clear";
+        case ProfileStage::Transform: return "Transform";
+        case ProfileStage::Cull: return "Cull";
+        case ProfileStage::Setup: return "Setup";
+        case ProfileStage::Raster: return "Raster";
+        case ProfileStage::Shade: return "Shade";
+        case ProfileStage::Resolve: return "Resolve";
+        case ProfileStage::TextureUpload: return "Texture Upload";
+        case ProfileStage::UI: return "UI";
+        default: return "Unknown";
+    }
+}
+
+void SetProfileThreadName(const std::string& name)
+{
+    TraceBuffer& buffer = GetThreadTraceBuffer();
+    std::lock_guard lock{g_trace_buffers_mutex};
+    buffer.thread_name = name;
+}
+
+void ArmTraceCapture(const int frame_count)
+{
+    g_trace_capture_requested_frames = std::max(frame_count, 0);
+}
+
+void DisarmTraceCapture()
+{
+    g_trace_capture_requested_frames = -1;
+    g_trace_capture_frames_left = 0;
+    g_is_trace_capture_armed.store(false, std::memory_order_relaxed);
+}
+
+bool HasTraceCaptureFinished()
+{
+    return g_has_trace_capture_finished;
+}
+
+void RecordTraceEvent(const char* name, const int64_t start_nanoseconds, const int64_t end_nanoseconds)
+{
+    if(!IsTraceCaptureArmed())
+    {
+        return;
+    }
+
+    TraceBuffer& buffer = GetThreadTraceBuffer();
+    const uint64_t index = buffer.write_count.load(std::memory_order_relaxed);
+    buffer.events[index & (k_trace_capacity - 1)] = {name, start_nanoseconds, end_nanoseconds};
+    buffer.write_count.store(index + 1, std::memory_order_release);
+}
+
+bool WriteChromeTrace(const std::string& path, const int frame_count)
+{
+    // everything that started after the oldest requested frame, on every thread
+    const int traced_frame_count = std::min(frame_count, GetProfiledFrameCount());
+    const int64_t first_timestamp = traced_frame_count > 0 ? GetProfileFrame(traced_frame_count - 1).start_nanoseconds : 0;
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    if(!file)
+    {
+        return false;
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    size_t event_count = 0;
+    std::vector<TraceEvent> events;
+    std::lock_guard lock{g_trace_buffers_mutex};
+    for(const auto& buffer : g_trace_buffers)
+    {
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            event_count == 0 ? "" : ",\n", buffer->thread_index, buffer->thread_name.c_str());
+        ++event_count;
+
+        // copy first, then drop whatever the owning thread may have overwritten while we were copying
+        const uint64_t end = buffer->write_count.load(std::memory_order_acquire);
+        const uint64_t begin = end > k_trace_capacity ? end - k_trace_capacity : 0;
+        events.clear();
+        for(uint64_t i = begin; i < end; ++i)
+        {
+            events.push_back(buffer->events[i & (k_trace_capacity - 1)]);
+        }
+
+        const uint64_t end_after_copy = buffer->write_count.load(std::memory_order_acquire);
+        const uint64_t overwritten = end_after_copy > k_trace_capacity ? end_after_copy - k_trace_capacity : 0;
+        const size_t first_valid = overwritten > begin ? (size_t)std::min<uint64_t>(overwritten - begin, events.size()) : 0;
+        for(size_t i = first_valid; i < events.size(); ++i)
+        {
+            const TraceEvent& event = events[i];
+            if(event.start_nanoseconds < first_timestamp)
+            {
+                continue;
+            }
+
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, buffer->thread_index,
+                (event.start_nanoseconds - first_timestamp) / 1000.0,
+                (event.end_nanoseconds - event.start_nanoseconds) / 1000.0);
+            ++event_count;
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+    Log("Wrote %zu trace events from %d frames to %s", event_count, traced_frame_count, path.c_str());
+    return true;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped timers around the pipeline stages. Every scope adds its duration to the current frame's
+// slot in a ring buffer, the overlay and the bench read rolling averages back out of it.
+// While a trace capture is armed every scope also lands in a per-thread trace buffer that WriteChromeTrace
+// dumps for chrome://tracing or Perfetto, the rest of the time scopes only pay for the stage times.
+// Build without DEMO3D_PROFILING and the PROFILE_ macros expand to nothing.
+
+enum class ProfileStage
+{
+    Clear,
+    Transform,
+    Cull,
+    Setup,
+    Raster,
+    Shade,
+    Resolve,
+    TextureUpload,
+    UI,
+    Count
+};
+
+constexpr int k_profile_stage_count = (int)ProfileStage::Count;
+constexpr int k_profile_history = 120;
+
+struct ProfileFrame
+{
+    int64_t stage_nanoseconds[k_profile_stage_count];
+    int64_t start_nanoseconds;
+    int64_t frame_nanoseconds;
+};
+
+struct ProfileAverages
+{
+    double stage_milliseconds[k_profile_stage_count];
+    double frame_milliseconds;
+};
+
+extern ProfileFrame g_profile_frames[k_profile_history];
+extern int g_profile_frame_index;
+extern std::atomic<bool> g_is_trace_capture_armed;
+
+void BeginProfileFrame();
+void EndProfileFrame();
+// frames_ago 0 is the last finished frame
+const ProfileFrame& GetProfileFrame(const int frames_ago);
+int GetProfiledFrameCount();
+ProfileAverages GetProfileAverages();
+const char* GetProfileStageName(const ProfileStage stage);
+
+// names the calling thread in traces, threads that never call it show up as "Thread <n>"
+void SetProfileThreadName(const std::string& name);
+// starts recording trace events with the next frame, for frame_count frames or until disarmed if it is 0
+void ArmTraceCapture(const int frame_count);
+void DisarmTraceCapture();
+// true right after the last frame of an armed capture ended, until the next frame begins
+bool HasTraceCaptureFinished();
+// name must outlive the trace, it is stored as is. Does nothing unless a capture is armed
+void RecordTraceEvent(const char* name, const int64_t start_nanoseconds, const int64_t end_nanoseconds);
+// writes the last frame_count frames of every thread's trace buffer as Chrome trace event JSON
+bool WriteChromeTrace(const std::string& path, const int frame_count);
+
+inline bool IsTraceCaptureArmed()
+{
+    return g_is_trace_capture_armed.load(std::memory_order_relaxed);
+}
+
+inline int64_t GetProfileTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void AddProfileStageTime(const ProfileStage stage, const int64_t nanoseconds)
+{
+    g_profile_frames[g_profile_frame_index].stage_nanoseconds[(int)stage] += nanoseconds;
+}
+
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(const ProfileStage stage)
+        : m_stage(stage), m_start(GetProfileTimestamp())
+    {
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+    ~ScopedStageTimer()
+    {
+        Stop();
+    }
+
+    // ends the scope early, for stages that don't line up with a block
+    void Stop()
+    {
+        if(m_is_stopped)
+        {
+            return;
+        }
+
+        m_is_stopped = true;
+        const int64_t end = GetProfileTimestamp();
+        AddProfileStageTime(m_stage, end - m_start);
+        if(IsTraceCaptureArmed())
+        {
+            RecordTraceEvent(GetProfileStageName(m_stage), m_start, end);
+        }
+    }
+
+private:
+    ProfileStage m_stage;
+    int64_t m_start;
+    bool m_is_stopped = false;
+};
+
+// Times stages that take turns inside one loop, switching costs a single timestamp instead of a scope's
+// pair, so it stays cheap where a scope per iteration would cost more than the work it times. Only adds
+// to the stage times, it records no trace events.
+class StageSplitTimer
+{
+public:
+    explicit StageSplitTimer(const ProfileStage stage)
+        : m_stage(stage), m_start(GetProfileTimestamp())
+    {
+    }
+
+    StageSplitTimer(const StageSplitTimer&) = delete;
+    StageSplitTimer& operator=(const StageSplitTimer&) = delete;
+
+    ~StageSplitTimer()
+    {
+        Stop();
+    }
+
+    // charges the time since the last switch to the current stage
+    void Switch(const ProfileStage stage)
+    {
+        if(m_is_stopped || stage == m_stage)
+        {
+            return;
+        }
+
+        const int64_t now = GetProfileTimestamp();
+        AddProfileStageTime(m_stage, now - m_start);
+        m_stage = stage;
+        m_start = now;
+    }
+
+    void Stop()
+    {
+        if(m_is_stopped)
+        {
+            return;
+        }
+
+        m_is_stopped = true;
+        AddProfileStageTime(m_stage, GetProfileTimestamp() - m_start);
+    }
+
+private:
+    ProfileStage m_stage;
+    int64_t m_start;
+    bool m_is_stopped = false;
+};
+
+#ifdef DEMO3D_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(stage) ScopedStageTimer PROFILE_CONCAT(profile_scope_, __LINE__){stage}
+#define PROFILE_NAMED_SCOPE(name, stage) ScopedStageTimer name{stage}
+#define PROFILE_NAMED_SPLIT(name, stage) StageSplitTimer name{stage}
+#define PROFILE_SWITCH(name, stage) name.Switch(stage)
+#define PROFILE_STOP(name) name.Stop()
+#define PROFILE_BEGIN_FRAME() BeginProfileFrame()
+#define PROFILE_END_FRAME() EndProfileFrame()
+#else
+#define PROFILE_SCOPE(stage)
+#define PROFILE_NAMED_SCOPE(name, stage)
+#define PROFILE_NAMED_SPLIT(name, stage)
+#define PROFILE_SWITCH(name, stage)
+#define PROFILE_STOP(name)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+#endif
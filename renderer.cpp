@@ -0,0 +1,901 @@
+#include "renderer.h"
+
+#include "counters.h"
+#include "log.h"
+#include "mesh_optimizer.h"
+#include "profiler.h"
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+MyMesh g_mesh;
+DirectionalLight g_main_light;
+ftype g_since_start = 0.0f;
+ftype g_frame_time = 0.0f;
+MyTexture g_sprite_atlas;
+TextureRegion g_atlas_region;
+bool g_is_rending_depth_buffer = false;
+bool g_draw_triangle_edges = false;
+TextureMapping g_texture_mapping = TextureMapping::Subdivided;
+OverdrawView g_overdraw_view = OverdrawView::Off;
+OverdrawStatistics g_overdraw_statistics;
+VertexFormat g_mesh_vertex_format = VertexFormat::Float;
+bool g_optimize_mesh = true;
+bool g_start_orthographic = false;
+// headless mode renders without a window or GPU context and writes frames to disk
+bool g_is_headless = false;
+
+struct Fragment
+{
+    int x;
+    int y;
+    ftype z;
+    glm::vec2 uv; // uv/w until the perspective divide, unless the mapping is affine
+    ftype w_reciprocal;
+    ftype lod;
+};
+
+constexpr int k_fragment_batch_size = 64;
+// fragments a triangle rasterizes before they get shaded, a whole number of batches
+constexpr int k_fragment_buffer_size = 4 * k_fragment_batch_size;
+// pixels between true divides in the subdivided mapping, divides the batch size evenly
+constexpr int k_perspective_span = 16;
+
+template<typename Index>
+void DrawMyMeshTriangles(Viewport& viewport, const MyMesh& mesh, const glm::mat4& object_to_screen);
+
+MyMesh LoadMeshAsset(const std::filesystem::path& path)
+{
+    // everything derived from the mesh gets built here so a reload only redoes the mesh's own work
+    MyMesh mesh = ParseObjFile(path);
+    if(g_optimize_mesh)
+    {
+        mesh = OptimizeMesh(mesh);
+    }
+
+    return CompressMesh(mesh, g_mesh_vertex_format);
+}
+
+MyTexture LoadTextureAsset(const std::filesystem::path& path)
+{
+    Image image = LoadImage(path.string().c_str());
+    if(!IsImageReady(image))
+    {
+        return {};
+    }
+
+    MyTexture texture{image, g_texture_layout};
+    UnloadImage(image);
+    return texture;
+}
+
+void InitializeCamera(Viewport& viewport, const glm::ivec4& transform, const ftype fov, const ftype zoom_speed)
+{
+    const ftype near_plane = 4.5f;
+    const ftype far_plane = 100.0f;
+    
+    MyCamera& camera = viewport.camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 15.0f);
+    camera.lookAt = glm::vec3(0.0f, 0.0f, 0.0f);
+    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+    camera.near_plane = near_plane;
+    camera.far_plane = far_plane;
+    camera.fov = fov;
+    camera.zoom_speed = zoom_speed;
+    camera.rotation_speed = 50.0f;
+    camera.is_orthographic = g_start_orthographic;
+    
+    viewport.transform = transform;
+    ReloadBuffers(viewport, (ftype)transform.z, (ftype)transform.w);
+    UpdateViewport(viewport, {1, 1});
+}
+
+bool ExportFrame(const Image& image, const std::string& path)
+{
+    const std::string extension = std::filesystem::path(path).extension().string();
+    if(extension != ".ppm")
+    {
+        // raylib handles .png, .bmp, .tga, .jpg and writes the pixels as they are for .raw
+        return ExportImage(image, path.c_str());
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        return false;
+    }
+
+    std::fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    const Color* pixels = (const Color*)image.data;
+    for(int i = 0; i < image.width * image.height; ++i)
+    {
+        const unsigned char rgb[] = {pixels[i].r, pixels[i].g, pixels[i].b};
+        std::fwrite(rgb, 1, sizeof(rgb), file);
+    }
+
+    return std::fclose(file) == 0;
+}
+
+Image ImportFrame(const std::string& path)
+{
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        return {};
+    }
+
+    int width = 0, height = 0, max_value = 0;
+    const bool is_valid_header = std::fscanf(file, "P6 %d %d %d", &width, &height, &max_value) == 3 && std::fgetc(file) != EOF;
+    if(!is_valid_header || width <= 0 || height <= 0 || max_value != 255)
+    {
+        std::fclose(file);
+        return {};
+    }
+
+    Image image = GenImageColor(width, height, BLACK);
+    Color* pixels = (Color*)image.data;
+    for(int i = 0; i < width * height; ++i)
+    {
+        unsigned char rgb[3];
+        if(std::fread(rgb, 1, sizeof(rgb), file) != sizeof(rgb))
+        {
+            UnloadImage(image);
+            std::fclose(file);
+            return {};
+        }
+
+        pixels[i] = {rgb[0], rgb[1], rgb[2], 255};
+    }
+
+    std::fclose(file);
+    return image;
+}
+
+uint64_t HashImage(const Image& image)
+{
+    // FNV-1a eight bytes at a time with an extra shift to mix the high bits back down, a checksum
+    // to tell frames apart rather than a hash for tables
+    constexpr uint64_t prime = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*)image.data;
+    const size_t size = (size_t)image.width * (size_t)image.height * sizeof(Color);
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+
+    for(; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    return (hash ^ ((uint64_t)image.width << 32 | (uint32_t)image.height)) * prime;
+}
+
+FrameHashes HashFrame(const Viewport& viewport)
+{
+    return {HashImage(viewport.color_buffer), HashImage(viewport.z_buffer)};
+}
+
+void UpdateViewport(Viewport& viewport, const glm::vec2 screen_resize_factor)
+{
+    viewport.transform.z = (ftype)glm::round(viewport.transform.z * screen_resize_factor.x);
+    viewport.transform.w = (ftype)glm::round(viewport.transform.w * screen_resize_factor.y);
+    const ftype width = (ftype)viewport.transform.z;
+    const ftype height = (ftype)viewport.transform.w;
+    MyCamera& camera = viewport.camera;
+
+    camera.aspect = width / height;
+
+    const glm::mat4 worldToCameraSpace = LookAt(camera.position, camera.lookAt, camera.up);
+    //LogMat4("World To Camera", worldToCameraSpace);
+
+    const glm::mat4 projectionMatrix = ProjectionMatrix(viewport);
+    //LogMat4("Projection", projectionMatrix);
+    
+    const glm::mat4 clipToScreenSpace = ClipToScreenSpaceMatrix(viewport);
+    //LogMat4("Clip To Screen", clipToScreenSpace);
+
+    camera.worldToScreenSpace = clipToScreenSpace * projectionMatrix * worldToCameraSpace;
+
+    if(screen_resize_factor.x == 1.0f || screen_resize_factor.y == 1.0f)
+    {
+        // only reload the z_buffer and color_buffer if the screen size has changed
+        return;
+    }
+
+    ReloadBuffers(viewport, width, height);
+}
+
+void ReloadBuffers(Viewport& viewport, const ftype width, const ftype height)
+{
+    if(IsImageReady(viewport.z_buffer))
+    {
+        UnloadImage(viewport.z_buffer);
+    }
+
+    if(IsTextureReady(viewport.z_tex2d))
+    {
+        UnloadTexture(viewport.z_tex2d);
+    }
+    
+    if(IsImageReady(viewport.color_buffer))
+    {
+        UnloadImage(viewport.color_buffer);
+    }
+    
+    if(IsTextureReady(viewport.color_tex2d))
+    {
+        UnloadTexture(viewport.color_tex2d);
+    }
+    
+    // the buffers are plain CPU memory, textures only exist to show them in the window
+    viewport.z_buffer = GenImageColor((int)width, (int)height, WHITE);
+    viewport.color_buffer = GenImageColor((int)width, (int)height, BLACK);
+    InitializeFramebuffer(viewport.framebuffer, viewport.color_buffer, viewport.z_buffer, g_framebuffer_layout);
+    viewport.fragment_counts.assign((size_t)width * (size_t)height, 0);
+    viewport.depth_passed_counts.assign((size_t)width * (size_t)height, 0);
+    if(!g_is_headless)
+    {
+        viewport.z_tex2d = LoadTextureFromImage(viewport.z_buffer);
+        viewport.color_tex2d = LoadTextureFromImage(viewport.color_buffer);
+    }
+}
+
+void RenderWorld(Viewport& viewport)
+{
+    {
+        PROFILE_SCOPE(ProfileStage::Clear);
+        ClearFramebuffer(viewport.framebuffer, BLACK, WHITE);
+        if(g_overdraw_view != OverdrawView::Off)
+        {
+            std::fill(viewport.fragment_counts.begin(), viewport.fragment_counts.end(), 0);
+            std::fill(viewport.depth_passed_counts.begin(), viewport.depth_passed_counts.end(), 0);
+        }
+    }
+
+    DrawMyMesh(viewport, g_mesh);
+    if(VirtualTexture* virtual_texture = g_sprite_atlas.virtual_texture())
+    {
+        // headless frames wait for the pages they asked for, so every run renders the same images
+        virtual_texture->Update(g_is_headless);
+    }
+
+    {
+        PROFILE_SCOPE(ProfileStage::Resolve);
+        ResolveFramebuffer(viewport.framebuffer);
+    }
+
+    if(g_overdraw_view != OverdrawView::Off)
+    {
+        DrawOverdrawHeatMap(viewport);
+        // the heat map covers the whole color image, the next frame has to clear every tile
+        InvalidateFramebuffer(viewport.framebuffer);
+    }
+
+    if(g_is_headless)
+    {
+        return;
+    }
+
+    PROFILE_SCOPE(ProfileStage::TextureUpload);
+    if(g_is_rending_depth_buffer)
+    {
+        UpdateTexture(viewport.z_tex2d, viewport.z_buffer.data);
+        DrawTexture(viewport.z_tex2d, 0, 0, WHITE);
+        return;
+    }
+
+    UpdateTexture(viewport.color_tex2d, viewport.color_buffer.data);
+    DrawTexture(viewport.color_tex2d, 0, 0, WHITE);
+}
+
+void DrawOverdrawHeatMap(Viewport& viewport)
+{
+    // replaces the shaded image, so the depth view still shows the real depth buffer
+    const std::vector<uint16_t>& counts = g_overdraw_view == OverdrawView::Rasterized ? viewport.fragment_counts : viewport.depth_passed_counts;
+    Color* pixels = (Color*)viewport.color_buffer.data;
+    g_overdraw_statistics = {};
+    for(size_t i = 0; i < counts.size(); ++i)
+    {
+        g_overdraw_statistics.rasterized_fragments += viewport.fragment_counts[i];
+        g_overdraw_statistics.depth_passed_fragments += viewport.depth_passed_counts[i];
+        g_overdraw_statistics.covered_pixels += viewport.fragment_counts[i] > 0 ? 1 : 0;
+        pixels[i] = GetHeatMapColor(counts[i]);
+    }
+}
+
+const char* GetTextureMappingName(const TextureMapping mapping)
+{
+    switch(mapping)
+    {
+        case TextureMapping::Affine: return "Affine";
+        case TextureMapping::Subdivided: return "Subdivided";
+        case TextureMapping::Exact: return "Exact";
+        default: return "Unknown";
+    }
+}
+
+Color GetHeatMapColor(const int count)
+{
+    // one step per extra fragment, anything drawn 8 or more times is white
+    static const Color ramp[] = {
+        {0, 0, 0, 255},
+        {0, 0, 160, 255},
+        {0, 120, 255, 255},
+        {0, 200, 120, 255},
+        {120, 230, 0, 255},
+        {255, 220, 0, 255},
+        {255, 130, 0, 255},
+        {230, 30, 0, 255},
+        {255, 255, 255, 255},
+    };
+
+    constexpr int ramp_size = sizeof(ramp) / sizeof(ramp[0]);
+    return ramp[std::min(count, ramp_size - 1)];
+}
+
+void DrawMyMesh(Viewport& viewport, const MyMesh& mesh)
+{
+    // decoding compressed positions is folded into the transform, it costs nothing per vertex
+    const glm::mat4 object_to_screen = viewport.camera.worldToScreenSpace * mesh.position_decode_matrix();
+    VisitIndexType(mesh, [&](auto index){
+        DrawMyMeshTriangles<decltype(index)>(viewport, mesh, object_to_screen);
+    });
+}
+
+template<typename Index>
+void DrawMyMeshTriangles(Viewport& viewport, const MyMesh& mesh, const glm::mat4& object_to_screen)
+{
+    const glm::vec4 light_color{0, 0, 0, 0};
+    COUNTER_ADD(Counter::TrianglesIn, mesh.triangle_count());
+    for(int i = 0; i < mesh.triangle_count(); ++i)
+    {
+        PROFILE_NAMED_SCOPE(fetch_timer, ProfileStage::Transform);
+        constexpr int vertex_count = 3;
+        ftype vertices[3 * vertex_count];
+        ftype uvs[2 * vertex_count];
+        ftype normals[3 * vertex_count];
+        GetMeshTriangle<Index>(mesh, i, vertices, uvs, normals);
+
+        Vertex a{{}}, b{{}}, c{{}};
+        Vertex* vertex_container[] = {&a, &b, &c};
+        for(int k = 0; k < vertex_count; ++k)
+        {
+            Vertex* vertex = vertex_container[k];
+            const ftype x = vertices[k * 3 + 0];
+            const ftype y = vertices[k * 3 + 1];
+            const ftype z = vertices[k * 3 + 2];
+            vertex->position = {x, y, z};
+
+            const ftype nx = normals[k * 3 + 0];
+            const ftype ny = normals[k * 3 + 1];
+            const ftype nz = normals[k * 3 + 2];
+            vertex->normal = {nx, ny, nz};
+
+            const ftype u = uvs[k * 2 + 0];
+            const ftype v = uvs[k * 2 + 1];
+            vertex->uv = {u, v};
+        }
+
+        PROFILE_STOP(fetch_timer);
+        Draw3dTriangle(viewport, object_to_screen, a, b, c, nullptr, light_color, g_draw_triangle_edges);
+    }
+}
+
+void DrawColorPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color)
+{
+    DrawPixel(viewport, x, y, z, color);
+}
+
+void DrawTextureSampledPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec2 uv, const ftype lod, const TextureRegion& region, const glm::vec4 add_color)
+{
+    // uvs arrive interpolated by DrawTriangle, affinely or perspective correct depending on g_texture_mapping
+    const glm::vec4 texture_color = SampleTexture(g_sprite_atlas, uv, lod, g_texture_filter, region);
+    COUNTER_ADD(Counter::FragmentsShaded, 1);
+    COUNTER_ADD(Counter::TexelsFetched, GetTexelsPerSample(g_texture_filter));
+    DrawTexelPixel(viewport, x, y, z, texture_color, add_color);
+}
+
+void DrawTexelPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 texture_color, const glm::vec4 add_color)
+{
+    DrawPixel(viewport, x, y, z, ModulateColor(texture_color, add_color));
+}
+
+void DrawPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color)
+{
+    const int screen_width = viewport.transform.z;
+    const int screen_height = viewport.transform.w;
+    const bool is_outside_z_bounds = z < -1 || z > 1;
+    const bool is_outside_screen_bounds = x < 0 || x >= screen_width || y < 0 || y >= screen_height;
+    if(is_outside_screen_bounds || is_outside_z_bounds)
+    {
+        COUNTER_ADD(Counter::FragmentsOutsideScreen, 1);
+        return;
+    }
+
+    const int pixel_index = y * screen_width + x;
+    if(g_overdraw_view != OverdrawView::Off)
+    {
+        ++viewport.fragment_counts[pixel_index];
+    }
+
+    Framebuffer& framebuffer = viewport.framebuffer;
+    TouchTile(framebuffer, x, y);
+    const size_t pixel_offset = GetPixelOffset(framebuffer, x, y);
+    Color* depth_pixels = GetDepthPixels(framebuffer);
+    const ftype z1 = z * 0.5f + 0.5f; // remap z from 0 to 1
+    const float depth = k_unorm8_to_float[depth_pixels[pixel_offset].b];
+    if(depth < z1)
+    {
+        // values closer to 1 are further away from the camera
+        COUNTER_ADD(Counter::FragmentsOccluded, 1);
+        return;
+    }
+
+    COUNTER_ADD(Counter::FragmentsWritten, 1);
+    if(g_overdraw_view != OverdrawView::Off)
+    {
+        ++viewport.depth_passed_counts[pixel_index];
+    }
+
+    depth_pixels[pixel_offset] = PackColor({z1, z1, z1, 1.0f});
+    GetColorPixels(framebuffer)[pixel_offset] = PackColor(color);
+}
+
+void Draw3dTriangle(Viewport& viewport, const glm::mat4& object_to_screen, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only)
+{
+    const MyCamera& camera = viewport.camera;
+    PROFILE_NAMED_SCOPE(cull_timer, ProfileStage::Cull);
+    glm::vec3 normal = (a.normal + b.normal + c.normal) / 3.0f;
+
+    const glm::vec3 look_at_direction = camera.lookAt - camera.position;
+    const bool is_backfacing = glm::dot(normal, look_at_direction) >= 0.0f;
+    if(is_backfacing)
+    {
+        COUNTER_ADD(Counter::TrianglesCulled, 1);
+        return;
+    }
+
+    PROFILE_STOP(cull_timer);
+    PROFILE_NAMED_SCOPE(transform_timer, ProfileStage::Transform);
+
+    const auto facingLightFactor = glm::clamp<ftype>(-glm::dot(g_main_light.direction, normal), 0.2f, 1);
+    glm::vec4 light_color = facingLightFactor * g_main_light.color;
+    light_color.a = 1.0f;
+
+    const glm::vec4 a_screen = TransformToScreen(object_to_screen, a.position);
+    const glm::vec4 b_screen = TransformToScreen(object_to_screen, b.position);
+    const glm::vec4 c_screen = TransformToScreen(object_to_screen, c.position);
+
+#ifdef DEMO3D_COUNTERS
+    const auto IsOutsideScreen = [&](const glm::vec4& p){
+        return p.x < 0 || p.x >= viewport.transform.z || p.y < 0 || p.y >= viewport.transform.w || p.z < -1 || p.z > 1;
+    };
+
+    if(IsOutsideScreen(a_screen) || IsOutsideScreen(b_screen) || IsOutsideScreen(c_screen))
+    {
+        COUNTER_ADD(Counter::TrianglesClipped, 1);
+    }
+#endif
+
+    const Vertex a1 = {a_screen, normal, a.uv, a_screen.w};
+    const Vertex b1 = {b_screen, normal, b.uv, b_screen.w};
+    const Vertex c1 = {c_screen, normal, c.uv, c_screen.w};
+    PROFILE_STOP(transform_timer);
+    DrawTriangle(viewport, a1, b1, c1, uv, light_color, edges_only);
+}
+
+void DrawTriangle(Viewport& viewport, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only)
+{
+    if(edges_only)
+    {
+        PROFILE_SCOPE(ProfileStage::Raster);
+        DrawFramebufferLine(viewport.framebuffer, {a.position.x, a.position.y}, {b.position.x, b.position.y}, WHITE);
+        DrawFramebufferLine(viewport.framebuffer, {b.position.x, b.position.y}, {c.position.x, c.position.y}, WHITE);
+        DrawFramebufferLine(viewport.framebuffer, {c.position.x, c.position.y}, {a.position.x, a.position.y}, WHITE);
+        return;
+    }
+
+    PROFILE_NAMED_SPLIT(stage_timer, ProfileStage::Setup);
+    int x1 = (int)glm::floor(a.position.x);
+    int y1 = (int)glm::floor(a.position.y);
+    int x2 = (int)glm::floor(b.position.x);
+    int y2 = (int)glm::floor(b.position.y);
+    int x3 = (int)glm::floor(c.position.x);
+    int y3 = (int)glm::floor(c.position.y);
+
+    if(y1 == y2 && y2 == y3)
+    {
+        // all points are on the same line, no need to draw anything
+        return;
+    }
+
+    if(y1 > y2)
+    {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+    }
+    
+    if(y1 > y3)
+    {
+        std::swap(x1, x3);
+        std::swap(y1, y3);
+    }
+
+    if(y2 > y3)
+    {
+        std::swap(x2, x3);
+        std::swap(y2, y3);
+    }
+    
+    const glm::vec3 a_to_b = b.position - a.position;
+    const glm::vec3 a_to_c = c.position - a.position;
+    // this is actually parallelogram area, but the ratio is the same between triangles and parallelograms
+    // when calculating the barycentric coordinates
+    const ftype triangle_area_recip = 1.0f / (a_to_c.x * a_to_b.y - a_to_c.y * a_to_b.x);
+
+    // u/w, v/w and 1/w are linear in screen space, dividing them gives back the perspective correct uv
+    const TextureMapping texture_mapping = g_texture_mapping;
+    const glm::vec2 a_uv_over_w = a.uv * a.w_reciprocal;
+    const glm::vec2 b_uv_over_w = b.uv * b.w_reciprocal;
+    const glm::vec2 c_uv_over_w = c.uv * c.w_reciprocal;
+
+    // The mip level comes from how far the uvs move per pixel. The barycentric weights are linear in screen
+    // space so their gradients are constant over the triangle, which makes the affine uv gradients
+    // constant too. Perspective correct uvs get theirs through the quotient rule wherever there is a true w,
+    // the subdivided mapping at the ends of its spans with the lod stepped in between like the uvs, the
+    // exact one per 2x2 pixel quad.
+    const TextureFilter texture_filter = g_texture_filter;
+    const glm::vec2 alpha_gradient = glm::vec2{a_to_b.y, -a_to_b.x} * triangle_area_recip;
+    const glm::vec2 beta_gradient = glm::vec2{-a_to_c.y, a_to_c.x} * triangle_area_recip;
+    // a region shrinks the texture the uvs span
+    const TextureRegion region = g_atlas_region;
+    const glm::vec2 texture_size = glm::vec2{(ftype)g_sprite_atlas.width(), (ftype)g_sprite_atlas.height()} * region.scale;
+    const auto GetLod = [&](const glm::vec2 uv_dx, const glm::vec2 uv_dy){
+        const glm::vec2 texel_dx = uv_dx * texture_size;
+        const glm::vec2 texel_dy = uv_dy * texture_size;
+        const ftype texels_per_pixel_squared = std::max(glm::dot(texel_dx, texel_dx), glm::dot(texel_dy, texel_dy));
+        return 0.5f * glm::log2(std::max(texels_per_pixel_squared, 1e-12f));
+    };
+
+    const glm::vec2 uv_ab = b.uv - a.uv;
+    const glm::vec2 uv_ac = c.uv - a.uv;
+    const ftype affine_lod = GetLod(alpha_gradient.x * uv_ac + beta_gradient.x * uv_ab, alpha_gradient.y * uv_ac + beta_gradient.y * uv_ab);
+    const glm::vec2 uv_over_w_ab = b_uv_over_w - a_uv_over_w;
+    const glm::vec2 uv_over_w_ac = c_uv_over_w - a_uv_over_w;
+    const glm::vec2 uv_over_w_dx = alpha_gradient.x * uv_over_w_ac + beta_gradient.x * uv_over_w_ab;
+    const glm::vec2 uv_over_w_dy = alpha_gradient.y * uv_over_w_ac + beta_gradient.y * uv_over_w_ab;
+    const ftype w_reciprocal_dx = alpha_gradient.x * (c.w_reciprocal - a.w_reciprocal) + beta_gradient.x * (b.w_reciprocal - a.w_reciprocal);
+    const ftype w_reciprocal_dy = alpha_gradient.y * (c.w_reciprocal - a.w_reciprocal) + beta_gradient.y * (b.w_reciprocal - a.w_reciprocal);
+    const auto GetPerspectiveLod = [&](const glm::vec2 uv, const ftype w){
+        return GetLod((uv_over_w_dx - uv * w_reciprocal_dx) * w, (uv_over_w_dy - uv * w_reciprocal_dy) * w);
+    };
+
+    const auto GetQuadLod = [&](const int x, const int y){
+        // evaluated at the quad's center so all four of its pixels agree
+        const glm::vec2 a_to_p{(x & ~1) + 0.5f - a.position.x, (y & ~1) + 0.5f - a.position.y};
+        const ftype alpha = (a_to_p.x * a_to_b.y - a_to_p.y * a_to_b.x) * triangle_area_recip;
+        const ftype beta = -(a_to_p.x * a_to_c.y - a_to_p.y * a_to_c.x) * triangle_area_recip;
+        const glm::vec2 uv_over_w = a_uv_over_w + alpha * uv_over_w_ac + beta * uv_over_w_ab;
+        const ftype w = 1.0f / (a.w_reciprocal + alpha * (c.w_reciprocal - a.w_reciprocal) + beta * (b.w_reciprocal - a.w_reciprocal));
+        return GetPerspectiveLod(uv_over_w * w, w);
+    };
+
+    // Fragments are rasterized into a buffer a batch at a time and shaded once it fills up or the triangle
+    // is done, so the stage timer switches between the two a few times per triangle instead of per batch
+    Fragment fragments[k_fragment_buffer_size];
+    int fragment_count = 0;
+    const auto ShadeFragments = [&](Viewport& viewport){
+        for(int batch_start = 0; batch_start < fragment_count; batch_start += k_fragment_batch_size)
+        {
+            const Fragment* batch = fragments + batch_start;
+            const int batch_count = std::min(k_fragment_batch_size, fragment_count - batch_start);
+            if(texture_filter == TextureFilter::Bilinear)
+            {
+                // the whole batch goes through the SIMD sampler at once
+                glm::vec2 uvs[k_fragment_batch_size];
+                ftype lods[k_fragment_batch_size];
+                Color texels[k_fragment_batch_size];
+                for(int i = 0; i < batch_count; ++i)
+                {
+                    uvs[i] = batch[i].uv;
+                    lods[i] = batch[i].lod;
+                }
+
+                SampleBilinearBatch(g_sprite_atlas, uvs, lods, batch_count, region, texels);
+                COUNTER_ADD(Counter::FragmentsShaded, batch_count);
+                COUNTER_ADD(Counter::TexelsFetched, batch_count * GetTexelsPerSample(texture_filter));
+                for(int i = 0; i < batch_count; ++i)
+                {
+                    DrawTexelPixel(viewport, batch[i].x, batch[i].y, batch[i].z, NormalizeColor(texels[i]), add_color);
+                }
+            }
+            else
+            {
+                for(int i = 0; i < batch_count; ++i)
+                {
+                    DrawTextureSampledPixel(viewport, batch[i].x, batch[i].y, batch[i].z, batch[i].uv, batch[i].lod, region, add_color);
+                }
+            }
+        }
+
+        fragment_count = 0;
+    };
+
+    const auto DrawTriangle = [&](Viewport& viewport, const int y_start, const int y_end, const int x_off_1, const int y_off_1, const int x_off_2, const int y_off_2, const ftype slope_1, const ftype slope_2){
+        for(int y = y_start; y < y_end; ++y)
+        {
+            int start_x = (int)glm::floor(slope_1 * (y - y_off_1)) + x_off_1;
+            int end_x = (int)glm::floor(slope_2 * (y - y_off_2)) + x_off_2;
+    
+            if(start_x > end_x)
+            {
+                std::swap(start_x, end_x);
+            }
+    
+            for(int batch_x = start_x; batch_x <= end_x; batch_x += k_fragment_batch_size)
+            {
+                if(fragment_count + k_fragment_batch_size > k_fragment_buffer_size)
+                {
+                    PROFILE_SWITCH(stage_timer, ProfileStage::Shade);
+                    ShadeFragments(viewport);
+                    PROFILE_SWITCH(stage_timer, ProfileStage::Raster);
+                }
+
+                Fragment* batch = fragments + fragment_count;
+                const int batch_count = std::min(k_fragment_batch_size, end_x - batch_x + 1);
+                fragment_count += batch_count;
+                COUNTER_ADD(Counter::FragmentsRasterized, batch_count);
+                for(int i = 0; i < batch_count; ++i)
+                {
+                    // calculate the barycentric coordinates
+                    const glm::vec2 a_to_p{batch_x + i - a.position.x, y - a.position.y};
+                    const ftype alpha = (a_to_p.x * a_to_b.y - a_to_p.y * a_to_b.x) * triangle_area_recip;
+                    const ftype beta = -(a_to_p.x * a_to_c.y - a_to_p.y * a_to_c.x) * triangle_area_recip;
+                    const ftype gamma = 1 - alpha - beta;
+
+                    batch[i].x = batch_x + i;
+                    batch[i].y = y;
+                    batch[i].z = gamma * a.position.z + alpha * c.position.z + beta * b.position.z;
+                    if(texture_mapping == TextureMapping::Affine)
+                    {
+                        batch[i].uv = gamma * a.uv + alpha * c.uv + beta * b.uv;
+                    }
+                    else
+                    {
+                        batch[i].uv = gamma * a_uv_over_w + alpha * c_uv_over_w + beta * b_uv_over_w;
+                        batch[i].w_reciprocal = gamma * a.w_reciprocal + alpha * c.w_reciprocal + beta * b.w_reciprocal;
+                    }
+                }
+
+                if(texture_mapping == TextureMapping::Exact)
+                {
+                    for(int i = 0; i < batch_count; ++i)
+                    {
+                        batch[i].uv /= batch[i].w_reciprocal;
+                    }
+                }
+                else if(texture_mapping == TextureMapping::Subdivided)
+                {
+                    // Quake style, a true divide every k_perspective_span pixels and affine steps in between,
+                    // each span's end is the next one's start. The lod steps the same way, from the divides'
+                    // results, nearest sampling has no use for it
+                    const bool is_lod_needed = texture_filter != TextureFilter::Nearest;
+                    const auto GetSpanEndLod = [&](const Fragment& fragment, const glm::vec2 uv){
+                        return is_lod_needed ? GetPerspectiveLod(uv, 1.0f / fragment.w_reciprocal) : 0.0f;
+                    };
+
+                    glm::vec2 start_uv = batch[0].uv / batch[0].w_reciprocal;
+                    ftype start_lod = GetSpanEndLod(batch[0], start_uv);
+                    for(int span_start = 0; span_start < batch_count; span_start += k_perspective_span)
+                    {
+                        const int span_end = std::min(span_start + k_perspective_span, batch_count - 1);
+                        const glm::vec2 end_uv = batch[span_end].uv / batch[span_end].w_reciprocal;
+                        const ftype end_lod = GetSpanEndLod(batch[span_end], end_uv);
+                        const glm::vec2 uv_step = span_end > span_start ? (end_uv - start_uv) / (ftype)(span_end - span_start) : glm::vec2{0.0f};
+                        const ftype lod_step = span_end > span_start ? (end_lod - start_lod) / (ftype)(span_end - span_start) : 0.0f;
+                        for(int i = span_start; i < span_end; ++i)
+                        {
+                            batch[i].uv = start_uv + uv_step * (ftype)(i - span_start);
+                            batch[i].lod = start_lod + lod_step * (ftype)(i - span_start);
+                        }
+
+                        start_uv = end_uv;
+                        start_lod = end_lod;
+                    }
+
+                    batch[batch_count - 1].uv = start_uv;
+                    batch[batch_count - 1].lod = start_lod;
+                }
+
+                if(texture_filter == TextureFilter::Nearest || texture_mapping == TextureMapping::Affine)
+                {
+                    const ftype lod = texture_filter == TextureFilter::Nearest ? 0.0f : affine_lod;
+                    for(int i = 0; i < batch_count; ++i)
+                    {
+                        batch[i].lod = lod;
+                    }
+                }
+                else if(texture_mapping == TextureMapping::Exact)
+                {
+                    ftype lod = 0.0f;
+                    for(int i = 0; i < batch_count; ++i)
+                    {
+                        const int x = batch_x + i;
+                        lod = i == 0 || (x & 1) == 0 ? GetQuadLod(x, y) : lod;
+                        batch[i].lod = lod;
+                    }
+                }
+            }
+        }
+    };
+
+    PROFILE_SWITCH(stage_timer, ProfileStage::Raster);
+
+    if(y1 == y2)
+    {
+        // top edge is horizontal
+        const ftype d_x3_y1 = (x3 - x1) / (ftype)(y3 - y1);
+        const ftype d_x3_y2 = (x3 - x2) / (ftype)(y3 - y2);
+        DrawTriangle(viewport, y2, y3, x1, y1, x2, y2, d_x3_y1, d_x3_y2);
+    }
+    else if(y2 == y3)
+    {
+        // bottom edge is horizontal
+        const ftype d_x2_y1 = (x2 - x1) / (ftype)(y2 - y1);
+        const ftype d_x3_y1 = (x3 - x1) / (ftype)(y3 - y1);
+        DrawTriangle(viewport, y1, y2, x1, y1, x1, y1, d_x2_y1, d_x3_y1);
+    }
+    else
+    {
+        const ftype d_x2_y1 = (x2 - x1) / (ftype)(y2 - y1);
+        const ftype d_x3_y1 = (x3 - x1) / (ftype)(y3 - y1);
+        const ftype d_x3_y2 = (x3 - x2) / (ftype)(y3 - y2);
+        DrawTriangle(viewport, y1, y2, x1, y1, x1, y1, d_x2_y1, d_x3_y1);
+        DrawTriangle(viewport, y2, y3, x1, y1, x2, y2, d_x3_y1, d_x3_y2);
+    }
+
+    PROFILE_SWITCH(stage_timer, ProfileStage::Shade);
+    ShadeFragments(viewport);
+}
+
+glm::mat4 ClipToScreenSpaceMatrix(const Viewport& viewport)
+{
+    const ftype x = (ftype)viewport.transform.x;
+    const ftype y = (ftype)viewport.transform.y;
+    const ftype viewport_half_width = viewport.transform.z * 0.5f;
+    const ftype viewport_half_height = viewport.transform.w * 0.5f;
+    const glm::vec4 column1{viewport_half_width, 0, 0, 0};
+    const glm::vec4 column2{0, -viewport_half_height, 0, 0};
+    const glm::vec4 column3{0, 0, 1, 0};
+    const glm::vec4 column4{x + viewport_half_width, y + viewport_half_height, 0, 1};
+    return Mat4(column1, column2, column3, column4);
+}
+
+glm::mat4 TRSMatrix(const glm::vec3 position, const glm::vec3 rotation_axis, const glm::vec3 scale, const float angle)
+{
+    return glm::translate(glm::mat4(1.0f), position) * RotationMatrix(rotation_axis, angle) * glm::scale(glm::mat4(1.0f), scale);
+}
+
+glm::mat4 ProjectionMatrix(const Viewport& viewport)
+{
+    const MyCamera& camera = viewport.camera;
+    return camera.is_orthographic 
+        ? OrthographicProjectionMatrix(camera.fov, camera.aspect, camera.near_plane, camera.far_plane, glm::length(camera.lookAt - camera.position)) 
+        : PerspectiveProjectionMatrix(camera.fov, camera.aspect, camera.near_plane, camera.far_plane);
+}
+
+glm::mat4 OrthographicProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far, const ftype focus_distance)
+{
+    // as big as the perspective frustum at the focus distance, so the looked at point keeps its size
+    // when the projection changes, and z goes from -1 at the near plane to 1 at the far one
+    const ftype height = focus_distance * glm::tan(glm::radians(fov * 0.5f));
+    const ftype width = aspect * height;
+    const ftype depth = far - near;
+    const glm::vec4 column1{1 / width, 0, 0, 0};
+    const glm::vec4 column2{0, 1 / height, 0, 0};
+    const glm::vec4 column3{0, 0, 2 / depth, 0};
+    const glm::vec4 column4{0, 0, -(far + near) / depth, 1};
+    return Mat4(column1, column2, -column3, column4);
+}
+
+glm::mat4 PerspectiveProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far)
+{
+    const ftype depth = far - near;
+    const ftype tan_fov = glm::tan(glm::radians(fov * 0.5f));
+    const glm::vec4 column1{1 / (aspect * tan_fov), 0, 0, 0};
+    const glm::vec4 column2{0, 1 / tan_fov, 0, 0};
+    const glm::vec4 column3{0, 0, (far + near) / depth, 1};
+    const glm::vec4 column4{0, 0, -2 * near * far / depth, 1};
+    return Mat4(column1, column2, -column3, column4);
+}
+
+glm::mat4 RotationMatrix(const glm::vec3 axis, const ftype angle)
+{
+    /*
+    v = (n * a)a
+    w = n - v
+    u = a x w
+    n' = v + cos(t)w + sin(t)u
+    */
+   const glm::vec3 rotation_axis = glm::normalize(axis);
+   const ftype cos_theta = glm::cos(angle);
+   const ftype sin_theta = glm::sin(angle);
+   glm::mat4 rot(1);
+
+   {
+       const glm::vec3 n = glm::vec3(1, 0, 0);
+       const glm::vec3 v = glm::dot(rotation_axis, n) * rotation_axis;
+       const glm::vec3 w = n - v;
+       const glm::vec3 u = glm::cross(rotation_axis, w);
+       rot[0][0] = v.x + cos_theta * w.x + sin_theta * u.x;
+       rot[0][1] = v.y + cos_theta * w.y + sin_theta * u.y;
+       rot[0][2] = v.z + cos_theta * w.z + sin_theta * u.z;
+   }
+   
+   {
+       const glm::vec3 n = glm::vec3(0, 1, 0);
+       const glm::vec3 v = glm::dot(rotation_axis, n) * rotation_axis;
+       const glm::vec3 w = n - v;
+       const glm::vec3 u = glm::cross(rotation_axis, w);
+       rot[1][0] = v.x + cos_theta * w.x + sin_theta * u.x;
+       rot[1][1] = v.y + cos_theta * w.y + sin_theta * u.y;
+       rot[1][2] = v.z + cos_theta * w.z + sin_theta * u.z;
+   }
+   
+   {
+       const glm::vec3 n = glm::vec3(0, 0, 1);
+       const glm::vec3 v = glm::dot(rotation_axis, n) * rotation_axis;
+       const glm::vec3 w = n - v;
+       const glm::vec3 u = glm::cross(rotation_axis, w);
+       rot[2][0] = v.x + cos_theta * w.x + sin_theta * u.x;
+       rot[2][1] = v.y + cos_theta * w.y + sin_theta * u.y;
+       rot[2][2] = v.z + cos_theta * w.z + sin_theta * u.z;
+   }
+
+   return rot;
+}
+
+glm::mat4 LookAt(const glm::vec3 position, const glm::vec3 look_at, const glm::vec3 up)
+{
+    const glm::vec3 lookat_direction = glm::normalize(look_at - position);
+    const glm::vec3 right = glm::normalize(glm::cross(lookat_direction, up));
+    const glm::vec3 up_direction = glm::cross(right, lookat_direction);
+    const glm::vec4 column1{right.x, right.y, right.z, 0};
+    const glm::vec4 column2{up_direction.x, up_direction.y, up_direction.z, 0};
+    const glm::vec4 column3{lookat_direction.x, lookat_direction.y, lookat_direction.z, 0};
+    const glm::vec4 column4{position.x, position.y, position.z, 1};
+
+    return glm::inverse(Mat4(column1, column2, -column3, column4));
+}
+
+glm::mat4 Mat4(const glm::vec4 column1, const glm::vec4 column2, const glm::vec4 column3, const glm::vec4 column4)
+{
+    const glm::vec4& c1 = column1;
+    const glm::vec4& c2 = column2;
+    const glm::vec4& c3 = column3;
+    const glm::vec4& c4 = column4;
+    return glm::mat4{
+        //       row1  row2  row3  row4
+        /*Col 1*/c1.x, c1.y, c1.z, c1.w,
+        /*Col 2*/c2.x, c2.y, c2.z, c2.w,
+        /*Col 3*/c3.x, c3.y, c3.z, c3.w,
+        /*Col 4*/c4.x, c4.y, c4.z, c4.w
+    };
+}
+
+bool IsTopLeftOfTriangle(const glm::vec2 from, const glm::vec2 to)
+{
+    const glm::vec2 a_to_b = to - from;
+    const bool is_flat_edge = a_to_b.y == 0 && a_to_b.x < 0;
+    const bool is_left_edge = a_to_b.y > 0;
+    return is_flat_edge || is_left_edge;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "mesh.h"
+#include "texture.h"
+#include "viewport.h"
+
+#include <filesystem>
+#include <string>
+
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+    ftype w_reciprocal = 1.0f; // 1/w after projection, stays 1 for vertices given in screen space
+};
+
+enum class TextureMapping
+{
+    Affine,     // uvs interpolated in screen space, the PS1 wobble
+    Subdivided, // perspective correct every k_perspective_span pixels, affine in between
+    Exact,      // perspective correct at every pixel
+};
+
+enum class OverdrawView
+{
+    Off,
+    Rasterized,  // every fragment that landed on the pixel
+    DepthPassed, // only the fragments that won the depth test when they were drawn
+};
+
+struct OverdrawStatistics
+{
+    int64_t rasterized_fragments;
+    int64_t depth_passed_fragments;
+    int64_t covered_pixels;
+};
+
+struct FrameHashes
+{
+    uint64_t color;
+    uint64_t depth;
+};
+
+struct DirectionalLight
+{
+    glm::vec3 direction;
+    glm::vec4 color;
+    ftype intensity;
+};
+
+extern MyMesh g_mesh;
+extern DirectionalLight g_main_light;
+extern ftype g_since_start;
+extern ftype g_frame_time;
+extern MyTexture g_sprite_atlas;
+// the part of g_sprite_atlas the following draws sample, all of it by default
+extern TextureRegion g_atlas_region;
+// the wallpapers in WallpaperAtlas.png, 64x64 texels each with 1 texel gutters
+constexpr AtlasGrid k_wallpaper_atlas_grid{{3, 16}, {65, 65}, {64, 64}, {8, 15}};
+extern bool g_is_rending_depth_buffer;
+extern bool g_draw_triangle_edges;
+extern TextureMapping g_texture_mapping;
+extern OverdrawView g_overdraw_view;
+extern OverdrawStatistics g_overdraw_statistics;
+extern VertexFormat g_mesh_vertex_format;
+extern bool g_optimize_mesh;
+extern bool g_start_orthographic;
+// headless mode renders without a window or GPU context and writes frames to disk
+extern bool g_is_headless;
+
+MyMesh LoadMeshAsset(const std::filesystem::path& path);
+// builds the mip chain, the texture isn't ready when the image failed to load
+MyTexture LoadTextureAsset(const std::filesystem::path& path);
+bool ExportFrame(const Image& image, const std::string& path);
+// reads back a .ppm written by ExportFrame, the image isn't ready when that fails
+Image ImportFrame(const std::string& path);
+uint64_t HashImage(const Image& image);
+FrameHashes HashFrame(const Viewport& viewport);
+void InitializeCamera(Viewport& viewport, const glm::ivec4& transform, const ftype fov, const ftype zoom_speed);
+void UpdateViewport(Viewport& viewport, const glm::vec2 screen_resize_factor);
+void ReloadBuffers(Viewport& viewport, const ftype width, const ftype height);
+void RenderWorld(Viewport& viewport);
+void DrawOverdrawHeatMap(Viewport& viewport);
+Color GetHeatMapColor(const int count);
+const char* GetTextureMappingName(const TextureMapping mapping);
+void DrawMyMesh(Viewport& viewport, const MyMesh& mesh);
+void DrawColorPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color);
+void DrawTextureSampledPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec2 uv, const ftype lod, const TextureRegion& region, const glm::vec4 add_color);
+// shades an already sampled texture color
+void DrawTexelPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 texture_color, const glm::vec4 add_color);
+void DrawPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color);
+void Draw3dTriangle(Viewport& viewport, const glm::mat4& object_to_screen, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only);
+void DrawTriangle(Viewport& viewport, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only);
+glm::mat4 ClipToScreenSpaceMatrix(const Viewport& viewport);
+glm::mat4 TRSMatrix(const glm::vec3 position,const glm::vec3 rotation_axis,const glm::vec3 scale, const float angle);
+glm::mat4 ProjectionMatrix(const Viewport& viewport);
+glm::mat4 OrthographicProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far, const ftype focus_distance);
+glm::mat4 PerspectiveProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far);
+glm::mat4 RotationMatrix(const glm::vec3 axis, const ftype angle);
+glm::mat4 LookAt(const glm::vec3 position, const glm::vec3 look_at, const glm::vec3 up);
+glm::mat4 Mat4(const glm::vec4 column1, const glm::vec4 column2, const glm::vec4 column3, const glm::vec4 column4);
+bool IsTopLeftOfTriangle(const glm::vec2 from, const glm::vec2 to);
+
+// object space to screen space including the perspective divide, z stays in -1 to 1 and w becomes
+// 1/w for perspective correct interpolation
+inline glm::vec4 TransformToScreen(const glm::mat4& object_to_screen, const glm::vec3 position)
+{
+    const glm::vec4 screen = object_to_screen * glm::vec4(position, 1.0f);
+    return {glm::vec3(screen) / screen.w, 1.0f / screen.w};
+}
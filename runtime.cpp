@@ -1,18 +1,24 @@
+#include "asset_watcher.h"
 #include "log.h"
+#include "counters.h"
+#include "input_recording.h"
 #include "mesh.h"
-#include "viewport.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
 
 #define RAYGUI_IMPLEMENTATION
 #include "raygui_enums.h"
 #include "raygui.h"
 
-struct Vertex
-{
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 uv;
-};
-
 struct Cube
 {
     glm::vec3 position;
@@ -22,22 +28,22 @@ struct Cube
     float angular_speed;
 };
 
-struct DirectionalLight
+// Assets re-loaded by the watcher thread, waiting to be swapped in at the start of a frame
+struct ReloadedAssets
 {
-    glm::vec3 direction;
-    glm::vec4 color;
-    ftype intensity;
+    std::mutex mutex;
+    std::optional<MyMesh> mesh;
+    std::optional<MyTexture> sprite_atlas;
 };
 
-MyMesh g_mesh;
-DirectionalLight g_main_light;
+const std::filesystem::path g_assets_directory = "assets";
+std::filesystem::path g_mesh_path = g_assets_directory / "Suzanne.obj";
+//std::filesystem::path g_mesh_path = g_assets_directory / "Cube.obj";
+const std::filesystem::path g_sprite_atlas_path = g_assets_directory / "WallpaperAtlas.png";
+AssetWatcher g_asset_watcher;
+ReloadedAssets g_reloaded_assets;
 Viewport g_main_viewport;
 Viewport g_axis_viewport;
-ftype g_since_start = 0.0f;
-ftype g_frame_time = 0.0f;
-Image g_sprite_atlas;
-bool g_is_rending_depth_buffer = false;
-bool g_draw_triangle_edges = false;
 bool g_is_viewing_performance_metrics = false;
 float g_bias = 0.0f;
 float g_wall_x = 0;
@@ -45,113 +51,434 @@ float g_wall_y = 10;
 int g_wall_column = 0;
 int g_wall_row = 0;
 glm::vec2 g_ui_zone{175, 220};
-int g_pixels_outside_screen = 0;
-int g_pixels_behind_other_pixels = 0;
-int g_backfacing_triangles = 0;
-
+glm::ivec2 g_screen_size{800, 600};
+int g_headless_frame_count = 1;
+std::string g_headless_output_path = "frame_%04d.ppm";
+std::string g_trace_path = "trace.json";
+int g_trace_frame_count = 10;
+bool g_write_trace_on_exit = false;
+InputRecorder g_input_recorder;
+InputReplay g_input_replay;
+std::string g_record_path;
+std::string g_replay_path;
+
+void ParseCommandLine(const int argc, char** argv);
 void InitializeRuntime();
-void InitializeCamera(Viewport& viewport, const glm::ivec4& transform, const ftype fov, const ftype zoom_speed);
+void OnAssetChanged(const std::filesystem::path& path);
+void SwapReloadedAssets();
 void RunGame();
+void RunHeadless();
+bool FormatFramePath(const std::string& pattern, const int frame, std::string& path);
 void CloseGame();
-void Update();
+FrameInput GatherFrameInput();
+FrameInput GetNeutralFrameInput();
+FrameInput GetNextFrameInput();
+void Update(const FrameInput& input);
 void UpdateLight(DirectionalLight& light, const glm::vec2 move);
-void UpdateCamera(Viewport& viewport, const ftype zoom, const glm::vec2 move, const glm::vec2 screen_resize_factor);
-void UpdateViewport(Viewport& viewport, const glm::vec2 screen_resize_factor);
-void ReloadBuffers(Viewport& viewport, const ftype width, const ftype height);
+void UpdateCamera(Viewport& viewport, const ftype zoom, const glm::vec2 move, const glm::vec2 screen_resize_factor, const bool toggle_projection);
 void Render();
-void RenderWorld(Viewport& viewport);
 void RenderUI();
 void DrawPerformanceMetrics();
-void DrawMyMesh(Viewport& viewport, const MyMesh& mesh);
+void DrawStageTimings(const int x, const int y);
 void DrawAxis(const Viewport& viewport, const glm::vec4 position);
 void DrawLine3d(const Viewport& viewport, const glm::vec4 start, const glm::vec4 end, const glm::vec4 color);
-void DrawColorPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color);
-void DrawTextureSampledPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec2 uv, const glm::vec4 add_color);
-void DrawPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color);
-void Draw3dTriangle(Viewport& viewport, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only);
-void DrawTriangle(Viewport& viewport, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only);
 ftype GetSmoothedMouseWheelScroll();
 glm::vec2 GetSmoothedMouseMove(const int button);
 glm::vec2 GetScreenResizeFactor();
-glm::mat4 ClipToScreenSpaceMatrix(const Viewport& viewport);
-glm::mat4 TRSMatrix(const glm::vec3 position,const glm::vec3 rotation_axis,const glm::vec3 scale, const float angle);
-glm::mat4 ProjectionMatrix(const Viewport& viewport);
-glm::mat4 OrthographicProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far);
-glm::mat4 PerspectiveProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far);
-glm::mat4 RotationMatrix(const glm::vec3 axis, const ftype angle);
-glm::mat4 LookAt(const glm::vec3 position, const glm::vec3 look_at, const glm::vec3 up);
-glm::mat4 Mat4(const glm::vec4 column1, const glm::vec4 column2, const glm::vec4 column3, const glm::vec4 column4);
-bool IsTopLeftOfTriangle(const glm::vec2 from, const glm::vec2 to);
-
-int main() 
+
+int main(int argc, char** argv)
 {
+    ParseCommandLine(argc, argv);
     InitializeRuntime();
     RunGame();
     CloseGame();
 }
 
+void ParseCommandLine(const int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if(arg == "--compress-vertices")
+        {
+            g_mesh_vertex_format = VertexFormat::Compressed;
+        }
+        else if(arg == "--compress-vertices-oct8")
+        {
+            g_mesh_vertex_format = VertexFormat::CompressedOct8;
+        }
+        else if(arg == "--no-mesh-optimization")
+        {
+            g_optimize_mesh = false;
+        }
+        else if(arg == "--mesh" && i + 1 < argc)
+        {
+            g_mesh_path = argv[++i];
+        }
+        else if(arg == "--size" && i + 1 < argc)
+        {
+            int width = 0, height = 0;
+            if(std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            {
+                g_screen_size = {width, height};
+            }
+        }
+        else if(arg == "--headless")
+        {
+            g_is_headless = true;
+        }
+        else if(arg == "--frames" && i + 1 < argc)
+        {
+            g_headless_frame_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--output" && i + 1 < argc)
+        {
+            // checked here so a bad pattern fails before rendering anything
+            std::string path;
+            if(FormatFramePath(argv[++i], 0, path))
+            {
+                g_headless_output_path = argv[i];
+            }
+            else
+            {
+                LogWarning("Ignoring --output %s, it may only hold one %%d or %%0Nd and %%%% for a literal %%", argv[i]);
+            }
+        }
+        else if(arg == "--orthographic")
+        {
+            g_start_orthographic = true;
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            g_trace_path = argv[++i];
+            g_write_trace_on_exit = true;
+        }
+        else if(arg == "--record" && i + 1 < argc)
+        {
+            g_record_path = argv[++i];
+        }
+        else if(arg == "--replay" && i + 1 < argc)
+        {
+            g_replay_path = argv[++i];
+        }
+        else if(arg == "--trace-frames" && i + 1 < argc)
+        {
+            g_trace_frame_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--depth-view")
+        {
+            g_is_rending_depth_buffer = true;
+        }
+        else if(arg == "--wireframe")
+        {
+            g_draw_triangle_edges = true;
+        }
+        else if(arg == "--overdraw-view")
+        {
+            g_overdraw_view = OverdrawView::Rasterized;
+        }
+        else if(arg == "--overdraw-view-depth-passed")
+        {
+            g_overdraw_view = OverdrawView::DepthPassed;
+        }
+        else if(arg == "--no-mipmaps")
+        {
+            g_texture_filter = TextureFilter::Nearest;
+        }
+        else if(arg == "--nearest-mip")
+        {
+            g_texture_filter = TextureFilter::NearestMip;
+        }
+        else if(arg == "--trilinear")
+        {
+            g_texture_filter = TextureFilter::Trilinear;
+        }
+        else if(arg == "--blocked-textures")
+        {
+            g_texture_layout = TextureLayout::Blocked4x4;
+        }
+        else if(arg == "--morton-textures")
+        {
+            g_texture_layout = TextureLayout::Morton;
+        }
+        else if(arg == "--bc1-textures")
+        {
+            g_texture_layout = TextureLayout::Bc1;
+        }
+        else if(arg == "--virtual-textures")
+        {
+            g_texture_layout = TextureLayout::Virtual;
+        }
+        else if(arg == "--tiled-framebuffer" && i + 1 < argc)
+        {
+            // 8 or 16 pixels square
+            g_framebuffer_layout = std::atoi(argv[++i]) == 16 ? FramebufferLayout::Tiled16x16 : FramebufferLayout::Tiled8x8;
+        }
+        else if(arg == "--affine-texture-mapping")
+        {
+            g_texture_mapping = TextureMapping::Affine;
+        }
+        else if(arg == "--exact-texture-mapping")
+        {
+            g_texture_mapping = TextureMapping::Exact;
+        }
+        else
+        {
+            LogWarning("Ignoring unknown argument %s", argv[i]);
+        }
+    }
+}
+
 void InitializeRuntime()
 {
-    const int screen_width = 800;
-    const int screen_height = 600;
-    InitWindow(screen_width, screen_height, "3D Demo");
-    //SetWindowState(FLAG_WINDOW_RESIZABLE);
-    GuiLoadStyleDefault();
+    const int screen_width = g_screen_size.x;
+    const int screen_height = g_screen_size.y;
+    if(!g_is_headless)
+    {
+        InitWindow(screen_width, screen_height, "3D Demo");
+        //SetWindowState(FLAG_WINDOW_RESIZABLE);
+        GuiLoadStyleDefault();
+    }
 
     SetTraceLogLevel(LOG_DEBUG);
+    SetProfileThreadName("Main");
+    if(g_write_trace_on_exit)
+    {
+        // the trace buffers keep the last frames, whichever those turn out to be
+        ArmTraceCapture(0);
+    }
 
     InitializeCamera(g_main_viewport, {0, 0, screen_width, screen_height}, 20.0f, 250.0f);
     InitializeCamera(g_axis_viewport, {screen_width - 100, 0, 100, 100}, 5.0f, 0.0f);
-    SetTargetFPS(60);
+    if(!g_replay_path.empty())
+    {
+        g_input_replay.Load(g_replay_path);
+    }
+
+    if(!g_record_path.empty())
+    {
+        g_input_recorder.Start(g_record_path);
+    }
 
-    g_sprite_atlas = LoadImage("assets/WallpaperAtlas.png");
-    g_mesh = ParseObjFile("assets/Suzanne.obj");
-    //g_mesh = ParseObjFile("assets/Cube.obj");
+    // a replay runs as fast as it can so it doubles as a benchmark
+    if(!g_is_headless && !g_input_replay.is_loaded())
+    {
+        SetTargetFPS(60);
+    }
+
+    g_virtual_page_budget = GetVirtualPageBudget(g_screen_size);
+    g_sprite_atlas = LoadTextureAsset(g_sprite_atlas_path);
+    g_mesh = LoadMeshAsset(g_mesh_path);
+    if(!g_is_headless)
+    {
+        g_asset_watcher.Start(g_assets_directory, OnAssetChanged);
+    }
 
     g_main_light.direction = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
     g_main_light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
     g_main_light.intensity = 1.0f;
 }
 
-void InitializeCamera(Viewport& viewport, const glm::ivec4& transform, const ftype fov, const ftype zoom_speed)
+void OnAssetChanged(const std::filesystem::path& path)
 {
-    const ftype near_plane = 4.5f;
-    const ftype far_plane = 100.0f;
-    
-    MyCamera& camera = viewport.camera;
-    camera.position = glm::vec3(0.0f, 0.0f, 15.0f);
-    camera.lookAt = glm::vec3(0.0f, 0.0f, 0.0f);
-    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
-    camera.near_plane = near_plane;
-    camera.far_plane = far_plane;
-    camera.fov = fov;
-    camera.zoom_speed = zoom_speed;
-    camera.rotation_speed = 50.0f;
-    camera.is_orthographic = false;
-    
-    viewport.transform = transform;
-    ReloadBuffers(viewport, (ftype)transform.z, (ftype)transform.w);
-    UpdateViewport(viewport, {1, 1});
+    // runs on the watcher thread, the render thread picks the result up in SwapReloadedAssets
+    if(path.filename() == g_mesh_path.filename())
+    {
+        MyMesh mesh;
+        try
+        {
+            mesh = LoadMeshAsset(path);
+        }
+        catch(const std::exception& e)
+        {
+            LogError("Failed to reload %s: %s", path.string().c_str(), e.what());
+            return;
+        }
+
+        if(mesh.triangle_count() == 0)
+        {
+            LogWarning("Ignoring reload of %s, it has no triangles", path.string().c_str());
+            return;
+        }
+
+        std::lock_guard lock{g_reloaded_assets.mutex};
+        g_reloaded_assets.mesh = std::move(mesh);
+    }
+    else if(path.filename() == g_sprite_atlas_path.filename())
+    {
+        // the mip chain gets built here too, off the render thread
+        MyTexture atlas = LoadTextureAsset(path);
+        if(!atlas.is_ready())
+        {
+            LogError("Failed to reload %s", path.string().c_str());
+            return;
+        }
+
+        std::lock_guard lock{g_reloaded_assets.mutex};
+        g_reloaded_assets.sprite_atlas = std::move(atlas);
+    }
+}
+
+void SwapReloadedAssets()
+{
+    // never stall the frame on the watcher thread, anything it is still writing gets picked up next frame
+    std::unique_lock lock{g_reloaded_assets.mutex, std::try_to_lock};
+    if(!lock.owns_lock())
+    {
+        return;
+    }
+
+    if(g_reloaded_assets.mesh)
+    {
+        g_mesh = std::move(*g_reloaded_assets.mesh);
+        g_reloaded_assets.mesh.reset();
+        Log("Swapped in reloaded mesh");
+    }
+
+    if(g_reloaded_assets.sprite_atlas)
+    {
+        g_sprite_atlas = std::move(*g_reloaded_assets.sprite_atlas);
+        g_reloaded_assets.sprite_atlas.reset();
+        Log("Swapped in reloaded sprite atlas");
+    }
 }
 
 void RunGame()
 {
+    if(g_is_headless)
+    {
+        RunHeadless();
+        return;
+    }
+
+    ftype replay_time = 0.0f;
     while (!WindowShouldClose()) 
     {
+        if(g_input_replay.is_loaded() && g_input_replay.is_finished())
+        {
+            break;
+        }
+
         g_since_start = (ftype)GetTime();
         g_frame_time = GetFrameTime();
-        Update();
+        PROFILE_BEGIN_FRAME();
+        SwapReloadedAssets();
+        const FrameInput input = GetNextFrameInput();
+        if(g_input_replay.is_loaded())
+        {
+            // replays step by the recorded frame times, never the wall clock
+            g_frame_time = input.frame_time;
+            g_since_start = replay_time;
+            replay_time += input.frame_time;
+        }
+
+        Update(input);
         Render();
+        PROFILE_END_FRAME();
+        if(HasTraceCaptureFinished() && !WriteChromeTrace(g_trace_path, g_trace_frame_count))
+        {
+            LogError("Failed to write trace to %s", g_trace_path.c_str());
+        }
     }
 }
 
+void RunHeadless()
+{
+    // fixed timestep, nothing in headless mode depends on the wall clock. There is no window to read
+    // input from, frames either replay a recording or get neutral input
+    constexpr ftype frame_time = 1.0f / 60.0f;
+    const int frame_count = g_input_replay.is_loaded() ? g_input_replay.frame_count() : g_headless_frame_count;
+    ftype since_start = 0.0f;
+    for(int frame = 0; frame < frame_count; ++frame)
+    {
+        g_since_start = since_start;
+        g_frame_time = frame_time;
+        PROFILE_BEGIN_FRAME();
+        const FrameInput input = GetNextFrameInput();
+        g_frame_time = input.frame_time;
+        since_start += input.frame_time;
+        Update(input);
+        Render();
+        PROFILE_END_FRAME();
+        if(HasTraceCaptureFinished() && !WriteChromeTrace(g_trace_path, g_trace_frame_count))
+        {
+            LogError("Failed to write trace to %s", g_trace_path.c_str());
+        }
+
+        const Image& frame_image = g_is_rending_depth_buffer ? g_main_viewport.z_buffer : g_main_viewport.color_buffer;
+        std::string path;
+        FormatFramePath(g_headless_output_path, frame, path);
+        if(!ExportFrame(frame_image, path))
+        {
+            LogError("Failed to write frame %d to %s", frame, path.c_str());
+        }
+    }
+}
+
+bool FormatFramePath(const std::string& pattern, const int frame, std::string& path)
+{
+    // the pattern is not a printf format. One %d or %0Nd gets the frame number and %% is a literal %,
+    // anything else after a % makes it invalid
+    constexpr int max_width = 32;
+    path.clear();
+    bool has_frame_number = false;
+    for(size_t i = 0; i < pattern.size(); ++i)
+    {
+        if(pattern[i] != '%')
+        {
+            path += pattern[i];
+            continue;
+        }
+
+        if(i + 1 < pattern.size() && pattern[i + 1] == '%')
+        {
+            path += '%';
+            ++i;
+            continue;
+        }
+
+        size_t end = i + 1;
+        const bool is_zero_padded = end < pattern.size() && pattern[end] == '0';
+        end += is_zero_padded ? 1 : 0;
+        int width = 0;
+        for(; end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9'; ++end)
+        {
+            width = width * 10 + (pattern[end] - '0');
+            if(width > max_width)
+            {
+                return false;
+            }
+        }
+
+        if(has_frame_number || end >= pattern.size() || pattern[end] != 'd')
+        {
+            return false;
+        }
+
+        std::string number = std::to_string(frame);
+        if((int)number.size() < width)
+        {
+            number.insert(0, width - number.size(), is_zero_padded ? '0' : ' ');
+        }
+
+        path += number;
+        has_frame_number = true;
+        i = end;
+    }
+
+    return true;
+}
+
 void CloseGame()
 {
-    if(IsImageReady(g_sprite_atlas))
+    g_input_recorder.Stop();
+    if(g_write_trace_on_exit && !WriteChromeTrace(g_trace_path, g_trace_frame_count))
     {
-        UnloadImage(g_sprite_atlas);
+        LogError("Failed to write trace to %s", g_trace_path.c_str());
     }
 
+    g_asset_watcher.Stop();
+
     Viewport viewports[] = {g_main_viewport, g_axis_viewport};
     for(auto& viewport : viewports)
     {
@@ -176,17 +503,80 @@ void CloseGame()
         }
     }
 
-    CloseWindow();
+    if(!g_is_headless)
+    {
+        CloseWindow();
+    }
+}
+
+FrameInput GatherFrameInput()
+{
+    FrameInput input = GetNeutralFrameInput();
+    input.zoom = GetSmoothedMouseWheelScroll();
+    input.camera_move = GetSmoothedMouseMove(MOUSE_LEFT_BUTTON);
+    input.light_move = GetSmoothedMouseMove(MOUSE_RIGHT_BUTTON);
+    input.screen_resize_factor = GetScreenResizeFactor();
+
+    const std::pair<int, uint32_t> key_toggles[] = {
+        {KEY_Z, k_toggle_depth_view},
+        {KEY_W, k_toggle_wireframe},
+        {KEY_S, k_toggle_metrics},
+        {KEY_SPACE, k_toggle_projection},
+        {KEY_O, k_toggle_overdraw_view},
+        {KEY_P, k_toggle_texture_mapping},
+        {KEY_M, k_toggle_texture_filter},
+        {KEY_T, k_toggle_write_trace},
+    };
+
+    for(const auto& [key, toggle] : key_toggles)
+    {
+        input.toggles |= IsKeyPressed(key) ? toggle : 0;
+    }
+
+    return input;
 }
 
-void Update()
+FrameInput GetNeutralFrameInput()
 {
-    const ftype zoom = GetSmoothedMouseWheelScroll();
-    const glm::vec2 left_mouse_delta = GetSmoothedMouseMove(MOUSE_LEFT_BUTTON);
-    const glm::vec2 right_mouse_delta = GetSmoothedMouseMove(MOUSE_RIGHT_BUTTON);
-    const glm::vec2 screen_resize_factor = GetScreenResizeFactor();
+    // nothing moves and nothing toggles, the UI values stay what they are
+    FrameInput input{};
+    input.frame_time = g_frame_time;
+    input.screen_resize_factor = {1.0f, 1.0f};
+    input.near_plane = g_main_viewport.camera.near_plane;
+    input.far_plane = g_main_viewport.camera.far_plane;
+    input.light_color = glm::vec3(g_main_light.color);
+    input.wall_x = g_wall_x;
+    input.wall_y = g_wall_y;
+    return input;
+}
 
-    const bool is_zkey_pressed = IsKeyPressed(KEY_Z);
+FrameInput GetNextFrameInput()
+{
+    FrameInput input;
+    if(!g_input_replay.Next(input))
+    {
+        input = g_is_headless ? GetNeutralFrameInput() : GatherFrameInput();
+    }
+
+    g_input_recorder.Record(input);
+    return input;
+}
+
+void Update(const FrameInput& input)
+{
+    // UI values first, a replay overrides whatever the sliders hold
+    g_main_viewport.camera.near_plane = input.near_plane;
+    g_main_viewport.camera.far_plane = input.far_plane;
+    g_main_light.color.r = input.light_color.r;
+    g_main_light.color.g = input.light_color.g;
+    g_main_light.color.b = input.light_color.b;
+    g_wall_x = input.wall_x;
+    g_wall_y = input.wall_y;
+    g_wall_column = (int)glm::round(g_wall_x);
+    g_wall_row = (int)glm::round(g_wall_y);
+    g_atlas_region = GetAtlasCellRegion(g_sprite_atlas, k_wallpaper_atlas_grid, g_wall_column, g_wall_row);
+
+    const bool is_zkey_pressed = (input.toggles & k_toggle_depth_view) != 0;
     if(is_zkey_pressed && !g_is_rending_depth_buffer)
     {
         g_is_rending_depth_buffer = true;
@@ -196,7 +586,7 @@ void Update()
         g_is_rending_depth_buffer = false;
     }
 
-    const bool is_wkey_pressed = IsKeyPressed(KEY_W);
+    const bool is_wkey_pressed = (input.toggles & k_toggle_wireframe) != 0;
     if(is_wkey_pressed & !g_draw_triangle_edges)
     {
         g_draw_triangle_edges = true;
@@ -206,7 +596,7 @@ void Update()
         g_draw_triangle_edges = false;
     }
 
-    const bool is_skey_pressed = IsKeyPressed(KEY_S);
+    const bool is_skey_pressed = (input.toggles & k_toggle_metrics) != 0;
     if(is_skey_pressed && !g_is_viewing_performance_metrics)
     {
         g_is_viewing_performance_metrics = true;
@@ -216,9 +606,42 @@ void Update()
         g_is_viewing_performance_metrics = false;
     }
 
-    UpdateLight(g_main_light, right_mouse_delta);
-    UpdateCamera(g_main_viewport, zoom, left_mouse_delta, screen_resize_factor);
-    UpdateCamera(g_axis_viewport, zoom, left_mouse_delta, screen_resize_factor);
+    if(input.toggles & k_toggle_overdraw_view)
+    {
+        // off -> rasterized -> depth passed -> off
+        g_overdraw_view = (OverdrawView)(((int)g_overdraw_view + 1) % 3);
+    }
+
+    if(input.toggles & k_toggle_texture_mapping)
+    {
+        // affine -> subdivided -> exact -> affine
+        g_texture_mapping = (TextureMapping)(((int)g_texture_mapping + 1) % 3);
+    }
+
+    if(input.toggles & k_toggle_texture_filter)
+    {
+        // nearest -> nearest mip -> bilinear -> trilinear -> nearest
+        g_texture_filter = (TextureFilter)(((int)g_texture_filter + 1) % 4);
+    }
+
+    if(input.toggles & k_toggle_write_trace)
+    {
+        // --trace records all along and can write the frames that just went by, otherwise the next
+        // frames get captured and written once they are done
+        if(!g_write_trace_on_exit)
+        {
+            ArmTraceCapture(g_trace_frame_count);
+        }
+        else if(!WriteChromeTrace(g_trace_path, g_trace_frame_count))
+        {
+            LogError("Failed to write trace to %s", g_trace_path.c_str());
+        }
+    }
+
+    const bool toggle_projection = (input.toggles & k_toggle_projection) != 0;
+    UpdateLight(g_main_light, input.light_move);
+    UpdateCamera(g_main_viewport, input.zoom, input.camera_move, input.screen_resize_factor, toggle_projection);
+    UpdateCamera(g_axis_viewport, input.zoom, input.camera_move, input.screen_resize_factor, toggle_projection);
 }
 
 void UpdateLight(DirectionalLight& light, const glm::vec2 move)
@@ -232,7 +655,7 @@ void UpdateLight(DirectionalLight& light, const glm::vec2 move)
     light.direction = length * glm::normalize(light.direction);
 }
 
-void UpdateCamera(Viewport& viewport, const ftype zoom, const glm::vec2 move, const glm::vec2 screen_resize_factor)
+void UpdateCamera(Viewport& viewport, const ftype zoom, const glm::vec2 move, const glm::vec2 screen_resize_factor, const bool toggle_projection)
 {
     MyCamera& camera = viewport.camera;
 
@@ -251,7 +674,7 @@ void UpdateCamera(Viewport& viewport, const ftype zoom, const glm::vec2 move, co
     camera.up = glm::cross(right, forward);
 
     bool do_update_projection_matrix = false;
-    do_update_projection_matrix = IsKeyPressed(KEY_SPACE);
+    do_update_projection_matrix = toggle_projection;
     camera.is_orthographic = do_update_projection_matrix ? !camera.is_orthographic : camera.is_orthographic;
 
     do_update_projection_matrix = viewport.last_fov != camera.fov || do_update_projection_matrix;
@@ -273,108 +696,39 @@ void UpdateCamera(Viewport& viewport, const ftype zoom, const glm::vec2 move, co
     }
 }
 
-void UpdateViewport(Viewport& viewport, const glm::vec2 screen_resize_factor)
+void Render()
 {
-    viewport.transform.z = (ftype)glm::round(viewport.transform.z * screen_resize_factor.x);
-    viewport.transform.w = (ftype)glm::round(viewport.transform.w * screen_resize_factor.y);
-    const ftype width = (ftype)viewport.transform.z;
-    const ftype height = (ftype)viewport.transform.w;
-    MyCamera& camera = viewport.camera;
-
-    camera.aspect = width / height;
-
-    const glm::mat4 worldToCameraSpace = LookAt(camera.position, camera.lookAt, camera.up);
-    //LogMat4("World To Camera", worldToCameraSpace);
-
-    const glm::mat4 projectionMatrix = ProjectionMatrix(viewport);
-    //LogMat4("Projection", projectionMatrix);
-    
-    const glm::mat4 clipToScreenSpace = ClipToScreenSpaceMatrix(viewport);
-    //LogMat4("Clip To Screen", clipToScreenSpace);
-
-    camera.worldToScreenSpace = clipToScreenSpace * projectionMatrix * worldToCameraSpace;
-
-    if(screen_resize_factor.x == 1.0f || screen_resize_factor.y == 1.0f)
+    if(g_is_headless)
     {
-        // only reload the z_buffer and color_buffer if the screen size has changed
+        RenderWorld(g_main_viewport);
+        AggregateCounters();
         return;
     }
 
-    ReloadBuffers(viewport, width, height);
-}
-
-void ReloadBuffers(Viewport& viewport, const ftype width, const ftype height)
-{
-    if(IsImageReady(viewport.z_buffer))
-    {
-        UnloadImage(viewport.z_buffer);
-    }
-
-    if(IsTextureReady(viewport.z_tex2d))
-    {
-        UnloadTexture(viewport.z_tex2d);
-    }
-    
-    if(IsImageReady(viewport.color_buffer))
-    {
-        UnloadImage(viewport.color_buffer);
-    }
-    
-    if(IsTextureReady(viewport.color_tex2d))
-    {
-        UnloadTexture(viewport.color_tex2d);
-    }
-    
-    viewport.z_buffer = GenImageColor((int)width, (int)height, WHITE);
-    viewport.z_tex2d = LoadTextureFromImage(viewport.z_buffer);
-    viewport.color_buffer = GenImageColor((int)width, (int)height, BLACK);
-    viewport.color_tex2d = LoadTextureFromImage(viewport.color_buffer);
-}
-
-void Render()
-{
-    // reset performance counters
-    g_backfacing_triangles = 0;
-    g_pixels_outside_screen = 0;
-    g_pixels_behind_other_pixels = 0;
-
     BeginDrawing();
     ClearBackground(BLACK);
     RenderWorld(g_main_viewport);
+    // before the UI so the metrics panel shows this frame's counts
+    AggregateCounters();
     RenderUI();
     EndDrawing();
 }
 
-void RenderWorld(Viewport& viewport)
-{
-    ImageClearBackground(&viewport.z_buffer, WHITE);
-    ImageClearBackground(&viewport.color_buffer, BLACK);
-
-    DrawMyMesh(viewport, g_mesh);
-
-    if(g_is_rending_depth_buffer)
-    {
-        UpdateTexture(viewport.z_tex2d, viewport.z_buffer.data);
-        DrawTexture(viewport.z_tex2d, 0, 0, WHITE);
-        return;
-    }
-
-    UpdateTexture(viewport.color_tex2d, viewport.color_buffer.data);
-    DrawTexture(viewport.color_tex2d, 0, 0, WHITE);
-}
-
 void RenderUI()
 {
+    PROFILE_SCOPE(ProfileStage::UI);
     DrawAxis(g_axis_viewport, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 
     MyCamera& camera = g_main_viewport.camera;
     std::string state = camera.is_orthographic ? "Orthographic" : "Perspective";
+    state = g_overdraw_view == OverdrawView::Rasterized ? "Overdraw (rasterized)" : state;
+    state = g_overdraw_view == OverdrawView::DepthPassed ? "Overdraw (depth passed)" : state;
     state = g_is_rending_depth_buffer ? "Depth Buffer" : state;
     Color text_color = g_is_rending_depth_buffer ? BLUE : YELLOW;
     DrawText(state.c_str(), 10, 10, 20, text_color);
 
-    GuiSlider({35, 30, 100, 20}, "Col", TextFormat("%d", g_wall_column), &g_wall_x, 0, 7);
-    GuiSlider({35, 50, 100, 20}, "Row", TextFormat("%d", g_wall_row), &g_wall_y, 0, 14);
+    GuiSlider({35, 30, 100, 20}, "Col", TextFormat("%d", g_wall_column), &g_wall_x, 0, k_wallpaper_atlas_grid.cell_count.x - 1);
+    GuiSlider({35, 50, 100, 20}, "Row", TextFormat("%d", g_wall_row), &g_wall_y, 0, k_wallpaper_atlas_grid.cell_count.y - 1);
     g_wall_column = (int)glm::round(g_wall_x);
     g_wall_row = (int)glm::round(g_wall_y);
     
@@ -398,49 +752,116 @@ void RenderUI()
 void DrawPerformanceMetrics()
 {
     constexpr int font_size = 20;
-    DrawRectangle(0, 0, (int)g_ui_zone.x, (int)g_ui_zone.y, Fade(BLACK, 0.8f));
+    constexpr int line_height = 20;
+#ifdef DEMO3D_COUNTERS
+    int line_count = 5 + k_counter_count;
+#else
+    int line_count = 5;
+#endif
+    line_count += g_overdraw_view != OverdrawView::Off ? 4 : 0;
+    const VirtualTexture* virtual_texture = g_sprite_atlas.virtual_texture();
+    line_count += virtual_texture ? 1 : 0;
+    const int panel_height = std::max((int)g_ui_zone.y, line_count * line_height + 20);
+    DrawRectangle(0, 0, 320, panel_height, Fade(BLACK, 0.8f));
+
+    int line_y = 10;
+    const auto DrawMetric = [&](const char* text){
+        DrawText(text, 10, line_y, font_size, YELLOW);
+        line_y += line_height;
+    };
+
+    DrawMetric(TextFormat("FPS: %d", GetFPS()));
+    DrawMetric(TextFormat("Texture mapping: %s", GetTextureMappingName(g_texture_mapping)));
+    DrawMetric(TextFormat("Texture filter: %s", GetTextureFilterName(g_texture_filter)));
+    DrawMetric(TextFormat("Texture layout: %s", GetTextureLayoutName(g_sprite_atlas.layout())));
+    DrawMetric(TextFormat("Framebuffer: %s", GetFramebufferLayoutName(g_main_viewport.framebuffer.layout)));
+    if(virtual_texture)
+    {
+        DrawMetric(TextFormat("Virtual pages: %d / %d", virtual_texture->resident_page_count(), virtual_texture->page_capacity()));
+    }
+
+#ifdef DEMO3D_COUNTERS
+    for(int counter = 0; counter < k_counter_count; ++counter)
+    {
+        DrawMetric(TextFormat("%s: %lld", GetCounterName((Counter)counter), (long long)GetFrameCounter((Counter)counter)));
+    }
+#endif
 
-    const int fps = GetFPS();
-    DrawText(TextFormat("FPS: %d", fps), 10, 10, font_size, YELLOW);
+    if(g_overdraw_view != OverdrawView::Off)
+    {
+        const OverdrawStatistics& overdraw = g_overdraw_statistics;
+        const double covered_pixels = (double)std::max<int64_t>(overdraw.covered_pixels, 1);
+        DrawMetric(TextFormat("Fragments: %lld", (long long)overdraw.rasterized_fragments));
+        DrawMetric(TextFormat("Depth passed: %lld", (long long)overdraw.depth_passed_fragments));
+        DrawMetric(TextFormat("Covered pixels: %lld", (long long)overdraw.covered_pixels));
+        DrawMetric(TextFormat("Overdraw: %.2f / %.2f", overdraw.rasterized_fragments / covered_pixels, overdraw.depth_passed_fragments / covered_pixels));
+    }
 
-    DrawText(TextFormat("Backfacing Triangles: %d", g_backfacing_triangles), 10, 30, font_size, YELLOW);
-    DrawText(TextFormat("Pixels Out-of-bounds: %d", g_pixels_outside_screen), 10, 50, font_size, YELLOW);
-    DrawText(TextFormat("Pixels behind pixles: %d", g_pixels_behind_other_pixels), 10, 70, font_size, YELLOW);
+#ifdef DEMO3D_PROFILING
+    DrawStageTimings(0, panel_height);
+#endif
 }
 
-void DrawMyMesh(Viewport& viewport, const MyMesh& mesh)
+void DrawStageTimings(const int x, const int y)
 {
-    const glm::vec4 light_color{0, 0, 0, 0};
-    for(int i = 0; i < mesh.triangle_count(); ++i)
+    static const Color stage_colors[k_profile_stage_count] = {GRAY, SKYBLUE, PURPLE, ORANGE, RED, GREEN, LIME, GOLD, PINK};
+    constexpr int font_size = 10;
+    constexpr int line_height = 12;
+    constexpr int bar_width = 2;
+    constexpr int graph_height = 80;
+    constexpr int width = k_profile_history * bar_width + 20;
+    constexpr int height = (k_profile_stage_count + 1) * line_height + graph_height + 30;
+    DrawRectangle(x, y, width, height, Fade(BLACK, 0.8f));
+
+    // rolling averages over the whole ring buffer
+    const ProfileAverages averages = GetProfileAverages();
+    for(int stage = 0; stage < k_profile_stage_count; ++stage)
     {
-        constexpr int vertex_count = 3;
-        ftype vertices[3 * vertex_count];
-        ftype uvs[2 * vertex_count];
-        ftype normals[3 * vertex_count];
-        GetMeshTriangle(mesh, i, vertices, uvs, normals);
+        const int line_y = y + 10 + stage * line_height;
+        DrawRectangle(x + 10, line_y, 8, 8, stage_colors[stage]);
+        DrawText(GetProfileStageName((ProfileStage)stage), x + 24, line_y, font_size, YELLOW);
+        DrawText(TextFormat("%.3f ms", averages.stage_milliseconds[stage]), x + 120, line_y, font_size, YELLOW);
+    }
+
+    const int frame_line_y = y + 10 + k_profile_stage_count * line_height;
+    DrawText("Frame", x + 24, frame_line_y, font_size, YELLOW);
+    DrawText(TextFormat("%.3f ms", averages.frame_milliseconds), x + 120, frame_line_y, font_size, YELLOW);
 
-        Vertex a{{}}, b{{}}, c{{}};
-        Vertex* vertex_container[] = {&a, &b, &c};
-        for(int k = 0; k < vertex_count; ++k)
+    // stacked graph, oldest frame on the left, scaled so a 60Hz frame always fits
+    const int frame_count = GetProfiledFrameCount();
+    double graph_milliseconds = 1000.0 / 60.0;
+    for(int i = 0; i < frame_count; ++i)
+    {
+        double stacked_milliseconds = 0.0;
+        for(int stage = 0; stage < k_profile_stage_count; ++stage)
         {
-            Vertex* vertex = vertex_container[k];
-            const ftype x = vertices[k * 3 + 0];
-            const ftype y = vertices[k * 3 + 1];
-            const ftype z = vertices[k * 3 + 2];
-            vertex->position = {x, y, z};
+            stacked_milliseconds += GetProfileFrame(i).stage_nanoseconds[stage] / 1000000.0;
+        }
 
-            const ftype nx = normals[k * 3 + 0];
-            const ftype ny = normals[k * 3 + 1];
-            const ftype nz = normals[k * 3 + 2];
-            vertex->normal = {nx, ny, nz};
+        graph_milliseconds = std::max(graph_milliseconds, stacked_milliseconds);
+    }
 
-            const ftype u = uvs[k * 2 + 0];
-            const ftype v = uvs[k * 2 + 1];
-            vertex->uv = {u, v};
+    const int graph_x = x + 10;
+    const int graph_bottom = y + height - 10;
+    const double pixels_per_millisecond = graph_height / graph_milliseconds;
+    for(int i = 0; i < frame_count; ++i)
+    {
+        const ProfileFrame& frame = GetProfileFrame(i);
+        const int bar_x = graph_x + (k_profile_history - 1 - i) * bar_width;
+        double stacked_milliseconds = 0.0;
+        for(int stage = 0; stage < k_profile_stage_count; ++stage)
+        {
+            const double milliseconds = frame.stage_nanoseconds[stage] / 1000000.0;
+            const int bar_top = graph_bottom - (int)((stacked_milliseconds + milliseconds) * pixels_per_millisecond);
+            const int bar_bottom = graph_bottom - (int)(stacked_milliseconds * pixels_per_millisecond);
+            DrawRectangle(bar_x, bar_top, bar_width, bar_bottom - bar_top, stage_colors[stage]);
+            stacked_milliseconds += milliseconds;
         }
-
-        Draw3dTriangle(viewport, a, b, c, nullptr, light_color, g_draw_triangle_edges);
     }
+
+    const int budget_y = graph_bottom - (int)(1000.0 / 60.0 * pixels_per_millisecond);
+    DrawLine(graph_x, budget_y, graph_x + k_profile_history * bar_width, budget_y, WHITE);
+    DrawText(TextFormat("%.1f ms", graph_milliseconds), graph_x, graph_bottom - graph_height - 12, font_size, WHITE);
 }
 
 void DrawAxis(const Viewport& viewport, const glm::vec4 position)
@@ -468,186 +889,6 @@ void DrawLine3d(const Viewport& viewport, const glm::vec4 start, const glm::vec4
     DrawLineEx({clippedStart.x, clippedStart.y}, {clippedEnd.x, clippedEnd.y}, 3.0f, raylib_color);
 }
 
-void DrawColorPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color)
-{
-    DrawPixel(viewport, x, y, z, color);
-}
-
-void DrawTextureSampledPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec2 uv, const glm::vec4 add_color)
-{
-    static const glm::mat2 uv_matrix{
-        g_sprite_atlas.width, 0,
-        0, g_sprite_atlas.height
-    };
-
-    // affine texture mapping (creates the wobbly textures characteristic of PS1 games)
-    const glm::vec2 uv1 = {glm::fract(uv.x), glm::fract(uv.y)};
-    const glm::vec2 texcoords = uv_matrix * uv1;
-    const int u = (int)glm::floor(texcoords.x);
-    const int v = (int)glm::floor(texcoords.y);
-    const Vector4 texture_color = ColorNormalize(GetImageColor(g_sprite_atlas, u, v));
-    const glm::vec4 final_color = {
-        texture_color.x * add_color.x, 
-        texture_color.y * add_color.y, 
-        texture_color.z * add_color.z, 
-        texture_color.w
-    };
-
-    DrawPixel(viewport, x, y, z, final_color);
-}
-
-void DrawPixel(Viewport& viewport, const int x, const int y, const ftype z, const glm::vec4 color)
-{
-    const int screen_width = viewport.transform.z;
-    const int screen_height = viewport.transform.w;
-    const bool is_outside_z_bounds = z < -1 || z > 1;
-    const bool is_outside_screen_bounds = x < 0 || x >= screen_width || y < 0 || y >= screen_height;
-    if(is_outside_screen_bounds || is_outside_z_bounds)
-    {
-        ++g_pixels_outside_screen;
-        return;
-    }
-
-    const ftype z1 = z * 0.5f + 0.5f; // remap z from 0 to 1
-    const float depth = ColorNormalize(GetImageColor(viewport.z_buffer, x, y)).z;
-    if(depth < z1)
-    {
-        // values closer to 1 are further away from the camera
-        ++g_pixels_behind_other_pixels;
-        return;
-    }
-
-    ImageDrawPixel(&viewport.z_buffer, x, y, ColorFromNormalized({z1, z1, z1, 1.0f}));
-    ImageDrawPixel(&viewport.color_buffer, x, y, ColorFromNormalized({color.r, color.g, color.b, color.a}));
-}
-
-void Draw3dTriangle(Viewport& viewport, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only)
-{
-    const MyCamera& camera = viewport.camera;
-    glm::vec3 normal = (a.normal + b.normal + c.normal) / 3.0f;
-
-    const glm::vec3 look_at_direction = camera.lookAt - camera.position;
-    const bool is_backfacing = glm::dot(normal, look_at_direction) >= 0.0f;
-    if(is_backfacing)
-    {
-        ++g_backfacing_triangles;
-        return;
-    }
-
-    const auto facingLightFactor = glm::clamp<ftype>(-glm::dot(g_main_light.direction, normal), 0.2f, 1);
-    glm::vec4 light_color = facingLightFactor * g_main_light.color;
-    light_color.a = 1.0f;
-
-    glm::vec4 a_screen = camera.worldToScreenSpace * glm::vec4(a.position, 1.0f);
-    glm::vec4 b_screen = camera.worldToScreenSpace * glm::vec4(b.position, 1.0f);
-    glm::vec4 c_screen = camera.worldToScreenSpace * glm::vec4(c.position, 1.0f);
-    a_screen /= a_screen.w;
-    b_screen /= b_screen.w;
-    c_screen /= c_screen.w;
-
-    const Vertex a1 = {a_screen, normal, a.uv};
-    const Vertex b1 = {b_screen, normal, b.uv};
-    const Vertex c1 = {c_screen, normal, c.uv};
-    DrawTriangle(viewport, a1, b1, c1, uv, light_color, edges_only);
-}
-
-void DrawTriangle(Viewport& viewport, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec2* uv, const glm::vec4 add_color, const bool edges_only)
-{
-    if(edges_only)
-    {
-        ImageDrawLineV(&viewport.color_buffer, {a.position.x, a.position.y}, {b.position.x, b.position.y}, WHITE);
-        ImageDrawLineV(&viewport.color_buffer, {b.position.x, b.position.y}, {c.position.x, c.position.y}, WHITE);
-        ImageDrawLineV(&viewport.color_buffer, {c.position.x, c.position.y}, {a.position.x, a.position.y}, WHITE);
-        return;
-    }
-
-    int x1 = (int)glm::floor(a.position.x);
-    int y1 = (int)glm::floor(a.position.y);
-    int x2 = (int)glm::floor(b.position.x);
-    int y2 = (int)glm::floor(b.position.y);
-    int x3 = (int)glm::floor(c.position.x);
-    int y3 = (int)glm::floor(c.position.y);
-
-    if(y1 == y2 && y2 == y3)
-    {
-        // all points are on the same line, no need to draw anything
-        return;
-    }
-
-    if(y1 > y2)
-    {
-        std::swap(x1, x2);
-        std::swap(y1, y2);
-    }
-    
-    if(y1 > y3)
-    {
-        std::swap(x1, x3);
-        std::swap(y1, y3);
-    }
-
-    if(y2 > y3)
-    {
-        std::swap(x2, x3);
-        std::swap(y2, y3);
-    }
-    
-    const glm::vec3 a_to_b = b.position - a.position;
-    const glm::vec3 a_to_c = c.position - a.position;
-    // this is actually parallelogram area, but the ratio is the same between triangles and parallelograms
-    // when calculating the barycentric coordinates
-    const ftype triangle_area_recip = 1.0f / (a_to_c.x * a_to_b.y - a_to_c.y * a_to_b.x);
-
-    const auto DrawTriangle = [&](Viewport& viewport, const int y_start, const int y_end, const int x_off_1, const int y_off_1, const int x_off_2, const int y_off_2, const ftype slope_1, const ftype slope_2){
-        for(int y = y_start; y < y_end; ++y)
-        {
-            int start_x = (int)glm::floor(slope_1 * (y - y_off_1)) + x_off_1;
-            int end_x = (int)glm::floor(slope_2 * (y - y_off_2)) + x_off_2;
-    
-            if(start_x > end_x)
-            {
-                std::swap(start_x, end_x);
-            }
-    
-            for(int x = start_x; x <= end_x; ++x)
-            {
-                // calculate the barycentric coordinates
-                const glm::vec2 a_to_p{x - a.position.x, y - a.position.y};
-                const ftype alpha = (a_to_p.x * a_to_b.y - a_to_p.y * a_to_b.x) * triangle_area_recip;
-                const ftype beta = -(a_to_p.x * a_to_c.y - a_to_p.y * a_to_c.x) * triangle_area_recip;
-                const ftype gamma = 1 - alpha - beta;
-                
-                const ftype z = gamma * a.position.z + alpha * c.position.z + beta * b.position.z;
-                DrawTextureSampledPixel(viewport, x, y, z, gamma * a.uv + alpha * c.uv + beta * b.uv, add_color);
-                //DrawColorPixel(viewport, x, y, z, glm::vec4(gamma, beta, alpha, 1.0f));
-            }
-        }
-    };
-
-    if(y1 == y2)
-    {
-        // top edge is horizontal
-        const ftype d_x3_y1 = (x3 - x1) / (ftype)(y3 - y1);
-        const ftype d_x3_y2 = (x3 - x2) / (ftype)(y3 - y2);
-        DrawTriangle(viewport, y2, y3, x1, y1, x2, y2, d_x3_y1, d_x3_y2);
-    }
-    else if(y2 == y3)
-    {
-        // bottom edge is horizontal
-        const ftype d_x2_y1 = (x2 - x1) / (ftype)(y2 - y1);
-        const ftype d_x3_y1 = (x3 - x1) / (ftype)(y3 - y1);
-        DrawTriangle(viewport, y1, y2, x1, y1, x1, y1, d_x2_y1, d_x3_y1);
-    }
-    else
-    {
-        const ftype d_x2_y1 = (x2 - x1) / (ftype)(y2 - y1);
-        const ftype d_x3_y1 = (x3 - x1) / (ftype)(y3 - y1);
-        const ftype d_x3_y2 = (x3 - x2) / (ftype)(y3 - y2);
-        DrawTriangle(viewport, y1, y2, x1, y1, x1, y1, d_x2_y1, d_x3_y1);
-        DrawTriangle(viewport, y2, y3, x1, y1, x2, y2, d_x3_y1, d_x3_y2);
-    }
-}
-
 ftype GetSmoothedMouseWheelScroll()
 {
     static ftype last_zoom = 0.0f;
@@ -675,134 +916,3 @@ glm::vec2 GetScreenResizeFactor()
     last_screen_height = GetScreenHeight();
     return {width_change_factor, height_change_factor};
 }
-
-glm::mat4 ClipToScreenSpaceMatrix(const Viewport& viewport)
-{
-    const ftype x = (ftype)viewport.transform.x;
-    const ftype y = (ftype)viewport.transform.y;
-    const ftype viewport_half_width = viewport.transform.z * 0.5f;
-    const ftype viewport_half_height = viewport.transform.w * 0.5f;
-    const glm::vec4 column1{viewport_half_width, 0, 0, 0};
-    const glm::vec4 column2{0, -viewport_half_height, 0, 0};
-    const glm::vec4 column3{0, 0, 1, 0};
-    const glm::vec4 column4{x + viewport_half_width, y + viewport_half_height, 0, 1};
-    return Mat4(column1, column2, column3, column4);
-}
-
-glm::mat4 TRSMatrix(const glm::vec3 position, const glm::vec3 rotation_axis, const glm::vec3 scale, const float angle)
-{
-    return glm::translate(glm::mat4(1.0f), position) * RotationMatrix(rotation_axis, angle) * glm::scale(glm::mat4(1.0f), scale);
-}
-
-glm::mat4 ProjectionMatrix(const Viewport& viewport)
-{
-    const MyCamera& camera = viewport.camera;
-    return camera.is_orthographic 
-        ? OrthographicProjectionMatrix(camera.fov, camera.aspect, camera.near_plane, camera.far_plane) 
-        : PerspectiveProjectionMatrix(camera.fov, camera.aspect, camera.near_plane, camera.far_plane);
-}
-
-glm::mat4 OrthographicProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far)
-{
-    const ftype height = near * glm::tan(glm::radians(fov * 0.5f));
-    const ftype width = aspect * height;
-    const ftype depth = far - near;
-    const glm::vec4 column1{1 / width, 0, 0, 0};
-    const glm::vec4 column2{0, 1 / height, 0, 0};
-    const glm::vec4 column3{0, 0, 1 / depth, 0};
-    const glm::vec4 column4{0, 0, -0.5f * (far + near), 1};
-    return Mat4(column1, column2, -column3, column4);
-}
-
-glm::mat4 PerspectiveProjectionMatrix(const ftype fov, const ftype aspect, const ftype near, const ftype far)
-{
-    const ftype depth = far - near;
-    const ftype tan_fov = glm::tan(glm::radians(fov * 0.5f));
-    const glm::vec4 column1{1 / (aspect * tan_fov), 0, 0, 0};
-    const glm::vec4 column2{0, 1 / tan_fov, 0, 0};
-    const glm::vec4 column3{0, 0, (far + near) / depth, 1};
-    const glm::vec4 column4{0, 0, -2 * near * far / depth, 1};
-    return Mat4(column1, column2, -column3, column4);
-}
-
-glm::mat4 RotationMatrix(const glm::vec3 axis, const ftype angle)
-{
-    /*
-    v = (n * a)a
-    w = n - v
-    u = a x w
-    n' = v + cos(t)w + sin(t)u
-    */
-   const glm::vec3 rotation_axis = glm::normalize(axis);
-   const ftype cos_theta = glm::cos(angle);
-   const ftype sin_theta = glm::sin(angle);
-   glm::mat4 rot(1);
-
-   {
-       const glm::vec3 n = glm::vec3(1, 0, 0);
-       const glm::vec3 v = glm::dot(rotation_axis, n) * rotation_axis;
-       const glm::vec3 w = n - v;
-       const glm::vec3 u = glm::cross(rotation_axis, w);
-       rot[0][0] = v.x + cos_theta * w.x + sin_theta * u.x;
-       rot[0][1] = v.y + cos_theta * w.y + sin_theta * u.y;
-       rot[0][2] = v.z + cos_theta * w.z + sin_theta * u.z;
-   }
-   
-   {
-       const glm::vec3 n = glm::vec3(0, 1, 0);
-       const glm::vec3 v = glm::dot(rotation_axis, n) * rotation_axis;
-       const glm::vec3 w = n - v;
-       const glm::vec3 u = glm::cross(rotation_axis, w);
-       rot[1][0] = v.x + cos_theta * w.x + sin_theta * u.x;
-       rot[1][1] = v.y + cos_theta * w.y + sin_theta * u.y;
-       rot[1][2] = v.z + cos_theta * w.z + sin_theta * u.z;
-   }
-   
-   {
-       const glm::vec3 n = glm::vec3(0, 0, 1);
-       const glm::vec3 v = glm::dot(rotation_axis, n) * rotation_axis;
-       const glm::vec3 w = n - v;
-       const glm::vec3 u = glm::cross(rotation_axis, w);
-       rot[2][0] = v.x + cos_theta * w.x + sin_theta * u.x;
-       rot[2][1] = v.y + cos_theta * w.y + sin_theta * u.y;
-       rot[2][2] = v.z + cos_theta * w.z + sin_theta * u.z;
-   }
-
-   return rot;
-}
-
-glm::mat4 LookAt(const glm::vec3 position, const glm::vec3 look_at, const glm::vec3 up)
-{
-    const glm::vec3 lookat_direction = glm::normalize(look_at - position);
-    const glm::vec3 right = glm::normalize(glm::cross(lookat_direction, up));
-    const glm::vec3 up_direction = glm::cross(right, lookat_direction);
-    const glm::vec4 column1{right.x, right.y, right.z, 0};
-    const glm::vec4 column2{up_direction.x, up_direction.y, up_direction.z, 0};
-    const glm::vec4 column3{lookat_direction.x, lookat_direction.y, lookat_direction.z, 0};
-    const glm::vec4 column4{position.x, position.y, position.z, 1};
-
-    return glm::inverse(Mat4(column1, column2, -column3, column4));
-}
-
-glm::mat4 Mat4(const glm::vec4 column1, const glm::vec4 column2, const glm::vec4 column3, const glm::vec4 column4)
-{
-    const glm::vec4& c1 = column1;
-    const glm::vec4& c2 = column2;
-    const glm::vec4& c3 = column3;
-    const glm::vec4& c4 = column4;
-    return glm::mat4{
-        //       row1  row2  row3  row4
-        /*Col 1*/c1.x, c1.y, c1.z, c1.w,
-        /*Col 2*/c2.x, c2.y, c2.z, c2.w,
-        /*Col 3*/c3.x, c3.y, c3.z, c3.w,
-        /*Col 4*/c4.x, c4.y, c4.z, c4.w
-    };
-}
-
-bool IsTopLeftOfTriangle(const glm::vec2 from, const glm::vec2 to)
-{
-    const glm::vec2 a_to_b = to - from;
-    const bool is_flat_edge = a_to_b.y == 0 && a_to_b.x < 0;
-    const bool is_left_edge = a_to_b.y > 0;
-    return is_flat_edge || is_left_edge;
-}
\ No newline at end of file
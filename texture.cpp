@@ -0,0 +1,494 @@
+#include "texture.h"
+
+#include "counters.h"
+#include "log.h"
+#include "virtual_texture.h"
+
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#ifdef DEMO3D_SSE2
+#include <emmintrin.h>
+#endif
+
+TextureFilter g_texture_filter = TextureFilter::Bilinear;
+TextureLayout g_texture_layout = TextureLayout::Linear;
+// starts at 1 so no level's tag is 0, the tag of an empty cache entry
+std::atomic<uint32_t> g_next_mip_level_id{1};
+
+static int CeilLog2(const int value)
+{
+    int bits = 0;
+    while((1 << bits) < value)
+    {
+        ++bits;
+    }
+
+    return bits;
+}
+
+// reorders a level built row after row, the padding texels stay zero and are never sampled
+template<TextureLayout layout>
+static void SwizzleLevel(MipLevel& level, const size_t size)
+{
+    std::vector<Color> swizzled(size, Color{});
+    for(int y = 0; y < level.height; ++y)
+    {
+        for(int x = 0; x < level.width; ++x)
+        {
+            swizzled[GetTexelIndex<layout>(level, x, y)] = level.texels[(size_t)y * level.width + x];
+        }
+    }
+
+    level.texels = std::move(swizzled);
+}
+
+static uint16_t PackRgb565(const Color color)
+{
+    return (uint16_t)((color.r >> 3) << 11 | (color.g >> 2) << 5 | color.b >> 3);
+}
+
+// low bits repeat the high ones so 0 and 31 or 63 map to 0 and 255
+static Color UnpackRgb565(const uint16_t packed)
+{
+    const int r = packed >> 11 & 31;
+    const int g = packed >> 5 & 63;
+    const int b = packed & 31;
+    return {(unsigned char)(r << 3 | r >> 2), (unsigned char)(g << 2 | g >> 4), (unsigned char)(b << 3 | b >> 2), 255};
+}
+
+// the first endpoint above the second selects 4 opaque colors, otherwise 3 and transparent black
+static void GetBc1Palette(const uint64_t block, Color palette[4])
+{
+    const uint16_t first = (uint16_t)block;
+    const uint16_t second = (uint16_t)(block >> 16);
+    palette[0] = UnpackRgb565(first);
+    palette[1] = UnpackRgb565(second);
+    const auto Blend = [&](const int first_weight, const int second_weight){
+        const int sum = first_weight + second_weight;
+        const auto Channel = [&](unsigned char Color::* channel){
+            return (unsigned char)((palette[0].*channel * first_weight + palette[1].*channel * second_weight) / sum);
+        };
+
+        return Color{Channel(&Color::r), Channel(&Color::g), Channel(&Color::b), 255};
+    };
+
+    if(first > second)
+    {
+        palette[2] = Blend(2, 1);
+        palette[3] = Blend(1, 2);
+    }
+    else
+    {
+        palette[2] = Blend(1, 1);
+        palette[3] = Color{0, 0, 0, 0};
+    }
+}
+
+static uint64_t EncodeBc1Block(const Color texels[16])
+{
+    // the endpoints are the opaque texels furthest apart along the principal axis of their colors
+    glm::vec3 mean{0.0f};
+    int opaque_count = 0;
+    for(int i = 0; i < 16; ++i)
+    {
+        if(texels[i].a >= 128)
+        {
+            mean += glm::vec3(texels[i].r, texels[i].g, texels[i].b);
+            ++opaque_count;
+        }
+    }
+
+    if(opaque_count == 0)
+    {
+        // both endpoints black in the 3 color mode and every index 3, fully transparent
+        return 0xffffffff00000000ull;
+    }
+
+    mean /= (float)opaque_count;
+    glm::vec3 covariance_rows[3] = {glm::vec3{0.0f}, glm::vec3{0.0f}, glm::vec3{0.0f}};
+    for(int i = 0; i < 16; ++i)
+    {
+        if(texels[i].a >= 128)
+        {
+            const glm::vec3 offset = glm::vec3(texels[i].r, texels[i].g, texels[i].b) - mean;
+            covariance_rows[0] += offset * offset.x;
+            covariance_rows[1] += offset * offset.y;
+            covariance_rows[2] += offset * offset.z;
+        }
+    }
+
+    // a few power iterations are plenty to find the dominant axis
+    glm::vec3 axis{1.0f, 1.0f, 1.0f};
+    for(int iteration = 0; iteration < 4; ++iteration)
+    {
+        const glm::vec3 next{glm::dot(covariance_rows[0], axis), glm::dot(covariance_rows[1], axis), glm::dot(covariance_rows[2], axis)};
+        const float length = glm::length(next);
+        if(length < 1e-6f)
+        {
+            break;
+        }
+
+        axis = next / length;
+    }
+
+    int low = -1;
+    int high = -1;
+    float low_projection = 0.0f;
+    float high_projection = 0.0f;
+    for(int i = 0; i < 16; ++i)
+    {
+        if(texels[i].a < 128)
+        {
+            continue;
+        }
+
+        const float projection = glm::dot(glm::vec3(texels[i].r, texels[i].g, texels[i].b), axis);
+        if(low < 0 || projection < low_projection)
+        {
+            low = i;
+            low_projection = projection;
+        }
+
+        if(high < 0 || projection > high_projection)
+        {
+            high = i;
+            high_projection = projection;
+        }
+    }
+
+    uint16_t first = PackRgb565(texels[high]);
+    uint16_t second = PackRgb565(texels[low]);
+    const bool has_transparent = opaque_count < 16;
+    if(has_transparent ? first > second : first < second)
+    {
+        std::swap(first, second);
+    }
+
+    uint64_t block = (uint64_t)first | (uint64_t)second << 16;
+    Color palette[4];
+    GetBc1Palette(block, palette);
+    const int opaque_palette_size = first > second ? 4 : 3;
+    for(int i = 0; i < 16; ++i)
+    {
+        int best_index = 3;
+        if(texels[i].a >= 128)
+        {
+            int best_distance = INT32_MAX;
+            for(int index = 0; index < opaque_palette_size; ++index)
+            {
+                const int r = texels[i].r - palette[index].r;
+                const int g = texels[i].g - palette[index].g;
+                const int b = texels[i].b - palette[index].b;
+                const int distance = r * r + g * g + b * b;
+                if(distance < best_distance)
+                {
+                    best_distance = distance;
+                    best_index = index;
+                }
+            }
+        }
+
+        block |= (uint64_t)best_index << (32 + i * 2);
+    }
+
+    return block;
+}
+
+// blocks over the edge of the level repeat its last row and column
+static void CompressLevel(MipLevel& level)
+{
+    level.blocks_per_row = (level.width + 3) / 4;
+    const int block_rows = (level.height + 3) / 4;
+    level.blocks.resize((size_t)block_rows * level.blocks_per_row);
+    for(int block_y = 0; block_y < block_rows; ++block_y)
+    {
+        for(int block_x = 0; block_x < level.blocks_per_row; ++block_x)
+        {
+            Color texels[16];
+            for(int i = 0; i < 16; ++i)
+            {
+                const int x = std::min(block_x * 4 + (i & 3), level.width - 1);
+                const int y = std::min(block_y * 4 + (i >> 2), level.height - 1);
+                texels[i] = level.texels[(size_t)y * level.width + x];
+            }
+
+            level.blocks[(size_t)block_y * level.blocks_per_row + block_x] = EncodeBc1Block(texels);
+        }
+    }
+
+    level.texels = {};
+}
+
+void DecodeBc1Block(const MipLevel& level, const int block_x, const int block_y, const uint64_t tag, DecodedBlock& decoded)
+{
+    COUNTER_ADD(Counter::TextureBlocksDecoded, 1);
+    const uint64_t block = level.blocks[(size_t)block_y * level.blocks_per_row + block_x];
+    Color palette[4];
+    GetBc1Palette(block, palette);
+    const uint32_t indices = (uint32_t)(block >> 32);
+    for(int i = 0; i < 16; ++i)
+    {
+        decoded.texels[i] = palette[indices >> (i * 2) & 3];
+    }
+
+    decoded.tag = tag;
+}
+
+static void SetLevelLayout(MipLevel& level, const TextureLayout layout)
+{
+    switch(layout)
+    {
+        case TextureLayout::Blocked4x4:
+        {
+            level.blocks_per_row = (level.width + 3) / 4;
+            const size_t block_rows = (level.height + 3) / 4;
+            SwizzleLevel<TextureLayout::Blocked4x4>(level, block_rows * level.blocks_per_row * 16);
+            break;
+        }
+        case TextureLayout::Morton:
+        {
+            const int width_bits = CeilLog2(level.width);
+            const int height_bits = CeilLog2(level.height);
+            level.morton_bits = std::min(width_bits, height_bits);
+            SwizzleLevel<TextureLayout::Morton>(level, (size_t)1 << (width_bits + height_bits));
+            break;
+        }
+        case TextureLayout::Bc1:
+            CompressLevel(level);
+            break;
+        default:
+            break;
+    }
+}
+
+MyTexture::MyTexture(const Image& image, const TextureLayout layout)
+    : m_layout(layout)
+{
+    if(!image.data || image.width <= 0 || image.height <= 0)
+    {
+        return;
+    }
+
+    // GetImageColor handles every uncompressed pixel format the loader can hand back
+    MipLevel base{image.width, image.height, 0, 0, 0, {}, {}};
+    base.texels.resize((size_t)image.width * image.height);
+    for(int y = 0; y < image.height; ++y)
+    {
+        for(int x = 0; x < image.width; ++x)
+        {
+            base.texels[(size_t)y * image.width + x] = GetImageColor(image, x, y);
+        }
+    }
+
+    m_levels.push_back(std::move(base));
+    while(m_levels.back().width > 1 || m_levels.back().height > 1)
+    {
+        const MipLevel& above = m_levels.back();
+        MipLevel level{std::max(1, above.width / 2), std::max(1, above.height / 2), 0, 0, 0, {}, {}};
+        level.texels.resize((size_t)level.width * level.height);
+        for(int y = 0; y < level.height; ++y)
+        {
+            for(int x = 0; x < level.width; ++x)
+            {
+                // odd sizes drop the last row or column, a 1 texel wide level reuses the same column
+                const int x0 = std::min(x * 2, above.width - 1);
+                const int x1 = std::min(x * 2 + 1, above.width - 1);
+                const int y0 = std::min(y * 2, above.height - 1);
+                const int y1 = std::min(y * 2 + 1, above.height - 1);
+                const Color texels[] = {
+                    above.texels[(size_t)y0 * above.width + x0],
+                    above.texels[(size_t)y0 * above.width + x1],
+                    above.texels[(size_t)y1 * above.width + x0],
+                    above.texels[(size_t)y1 * above.width + x1],
+                };
+
+                const auto Average = [&](unsigned char Color::* channel){
+                    const int sum = texels[0].*channel + texels[1].*channel + texels[2].*channel + texels[3].*channel;
+                    return (unsigned char)((sum + 2) / 4);
+                };
+
+                level.texels[(size_t)y * level.width + x] = {Average(&Color::r), Average(&Color::g), Average(&Color::b), Average(&Color::a)};
+            }
+        }
+
+        m_levels.push_back(std::move(level));
+    }
+
+    // the chain is built from row major levels, reorder them once it is complete
+    for(MipLevel& level : m_levels)
+    {
+        level.id = g_next_mip_level_id.fetch_add(1, std::memory_order_relaxed);
+        SetLevelLayout(level, layout);
+    }
+
+    if(layout == TextureLayout::Virtual)
+    {
+        m_virtual_texture = VirtualTexture::Create(m_levels, g_virtual_page_budget);
+        if(!m_virtual_texture)
+        {
+            LogWarning("Keeping the whole texture in memory instead");
+            m_layout = TextureLayout::Linear;
+            return;
+        }
+
+        for(int i = 0; i < (int)m_levels.size(); ++i)
+        {
+            m_levels[i].texels = {};
+            m_levels[i].virtual_texture = m_virtual_texture.get();
+            m_levels[i].virtual_level = i;
+        }
+    }
+}
+
+size_t MyTexture::memory_size() const
+{
+    size_t size = 0;
+    for(const MipLevel& level : m_levels)
+    {
+        size += level.texels.size() * sizeof(Color) + level.blocks.size() * sizeof(uint64_t);
+    }
+
+    size += m_virtual_texture ? m_virtual_texture->memory_size() : 0;
+
+    return size;
+}
+
+const char* GetTextureFilterName(const TextureFilter filter)
+{
+    switch(filter)
+    {
+        case TextureFilter::Nearest: return "Nearest";
+        case TextureFilter::NearestMip: return "Nearest mip";
+        case TextureFilter::Bilinear: return "Bilinear";
+        case TextureFilter::Trilinear: return "Trilinear";
+        default: return "Unknown";
+    }
+}
+
+TextureRegion GetTextureRegion(const MyTexture& texture, const Rectangle& texels)
+{
+    if(!texture.is_ready())
+    {
+        return {};
+    }
+
+    const glm::vec2 size{(float)texture.width(), (float)texture.height()};
+    return {glm::vec2(texels.width, texels.height) / size, glm::vec2(texels.x, texels.y) / size};
+}
+
+TextureRegion GetAtlasCellRegion(const MyTexture& texture, const AtlasGrid& grid, const int column, const int row)
+{
+    const int x = grid.origin.x + std::clamp(column, 0, grid.cell_count.x - 1) * grid.pitch.x;
+    const int y = grid.origin.y + std::clamp(row, 0, grid.cell_count.y - 1) * grid.pitch.y;
+    return GetTextureRegion(texture, {(float)x, (float)y, (float)grid.cell_size.x, (float)grid.cell_size.y});
+}
+
+#ifdef DEMO3D_SSE2
+// the left and right texel of a row, one 8 byte load when they sit next to each other in memory
+static inline __m128i LoadTexelPair(const Color* texels, const size_t left, const size_t right)
+{
+    if(right == left + 1)
+    {
+        return _mm_loadl_epi64((const __m128i*)(texels + left));
+    }
+
+    int left_texel, right_texel;
+    std::memcpy(&left_texel, texels + left, sizeof(left_texel));
+    std::memcpy(&right_texel, texels + right, sizeof(right_texel));
+    return _mm_unpacklo_epi32(_mm_cvtsi32_si128(left_texel), _mm_cvtsi32_si128(right_texel));
+}
+
+// channels widened to 16 bits, (a * (256 - weight) + b * weight) >> 8 stays below 65536
+static inline __m128i LerpChannels(const __m128i a, const __m128i b, const __m128i weights)
+{
+    const __m128i inverse_weights = _mm_sub_epi16(_mm_set1_epi16(256), weights);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, inverse_weights), _mm_mullo_epi16(b, weights)), 8);
+}
+
+// two pixels per register, four 16 bit channels each
+static inline __m128i SampleBilinearPair(const BilinearTaps& first, const BilinearTaps& second)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights_x = _mm_set_epi16(
+        (short)second.weight_x, (short)second.weight_x, (short)second.weight_x, (short)second.weight_x,
+        (short)first.weight_x, (short)first.weight_x, (short)first.weight_x, (short)first.weight_x);
+    const __m128i weights_y = _mm_set_epi16(
+        (short)second.weight_y, (short)second.weight_y, (short)second.weight_y, (short)second.weight_y,
+        (short)first.weight_y, (short)first.weight_y, (short)first.weight_y, (short)first.weight_y);
+
+    // left texels of both pixels in the low half and right ones in the high half, then widened
+    const __m128i top = _mm_shuffle_epi32(_mm_unpacklo_epi64(
+        LoadTexelPair(first.texels, first.top_left, first.top_right),
+        LoadTexelPair(second.texels, second.top_left, second.top_right)), _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i bottom = _mm_shuffle_epi32(_mm_unpacklo_epi64(
+        LoadTexelPair(first.texels, first.bottom_left, first.bottom_right),
+        LoadTexelPair(second.texels, second.bottom_left, second.bottom_right)), _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i top_row = LerpChannels(_mm_unpacklo_epi8(top, zero), _mm_unpackhi_epi8(top, zero), weights_x);
+    const __m128i bottom_row = LerpChannels(_mm_unpacklo_epi8(bottom, zero), _mm_unpackhi_epi8(bottom, zero), weights_x);
+    return LerpChannels(top_row, bottom_row, weights_y);
+}
+#endif
+
+template<TextureLayout layout>
+static void SampleBilinearBatch(const MyTexture& texture, const glm::vec2* uvs, const float* lods, const int count, const TextureRegion& region, Color* colors)
+{
+    const int last_level = texture.level_count() - 1;
+    Color gathered[4][4];
+    const auto GetTaps = [&](const int i, Color* pixel_gathered){
+        const int level = std::clamp((int)glm::round(lods[i]), 0, last_level);
+        return GetBilinearTaps<layout>(texture.level(level), glm::fract(uvs[i]) * region.scale + region.offset, pixel_gathered);
+    };
+
+    int i = 0;
+#ifdef DEMO3D_SSE2
+    for(; i + 4 <= count; i += 4)
+    {
+        const BilinearTaps taps[] = {GetTaps(i, gathered[0]), GetTaps(i + 1, gathered[1]), GetTaps(i + 2, gathered[2]), GetTaps(i + 3, gathered[3])};
+        const __m128i colors_01 = SampleBilinearPair(taps[0], taps[1]);
+        const __m128i colors_23 = SampleBilinearPair(taps[2], taps[3]);
+        _mm_storeu_si128((__m128i*)(colors + i), _mm_packus_epi16(colors_01, colors_23));
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        colors[i] = SampleBilinearTaps(GetTaps(i, gathered[0]));
+    }
+}
+
+void SampleBilinearBatch(const MyTexture& texture, const glm::vec2* uvs, const float* lods, const int count, const TextureRegion& region, Color* colors)
+{
+    switch(texture.layout())
+    {
+        case TextureLayout::Blocked4x4: SampleBilinearBatch<TextureLayout::Blocked4x4>(texture, uvs, lods, count, region, colors); break;
+        case TextureLayout::Morton: SampleBilinearBatch<TextureLayout::Morton>(texture, uvs, lods, count, region, colors); break;
+        case TextureLayout::Bc1: SampleBilinearBatch<TextureLayout::Bc1>(texture, uvs, lods, count, region, colors); break;
+        case TextureLayout::Virtual: SampleBilinearBatch<TextureLayout::Virtual>(texture, uvs, lods, count, region, colors); break;
+        default: SampleBilinearBatch<TextureLayout::Linear>(texture, uvs, lods, count, region, colors); break;
+    }
+}
+
+int GetTexelsPerSample(const TextureFilter filter)
+{
+    switch(filter)
+    {
+        case TextureFilter::Bilinear: return 4;
+        case TextureFilter::Trilinear: return 8;
+        default: return 1;
+    }
+}
+
+const char* GetTextureLayoutName(const TextureLayout layout)
+{
+    switch(layout)
+    {
+        case TextureLayout::Linear: return "Linear";
+        case TextureLayout::Blocked4x4: return "Blocked 4x4";
+        case TextureLayout::Morton: return "Morton";
+        case TextureLayout::Bc1: return "BC1";
+        case TextureLayout::Virtual: return "Virtual";
+        default: return "Unknown";
+    }
+}
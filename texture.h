@@ -0,0 +1,340 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "color.h"
+#include "raylib.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Textures the rasterizer samples from. The mip chain is built once when the texture is created, every
+// level is half the size of the one above it down to 1x1 and averages 2x2 texels of it. Sampling
+// repeats the texture outside 0 to 1.
+// Texels can be stored swizzled so texels that are close in 2D are close in memory, a walk across
+// the texture in any direction then stays within a few cache lines instead of touching a new row
+// every step. The samplers are templated on the layout, SampleTexture picks one per call.
+// Block compressed textures keep 4x4 texels in 8 bytes, BC1 style: two RGB565 endpoints and a 2 bit
+// index per texel into the palette between them. Fetches go through a small per thread cache of
+// decoded blocks so neighbouring samples decode a block once. Virtual textures keep their texels in
+// pages on disk and stream in the ones that get sampled, see virtual_texture.h.
+
+enum class TextureLayout
+{
+    Linear,     // row after row
+    Blocked4x4, // 4x4 texel blocks of 64 bytes, one cache line each, in rows of blocks
+    Morton,     // Z-order curve over the level padded to powers of two
+    Bc1,        // 4x4 texel blocks compressed to 8 bytes in rows of blocks, 1 bit alpha
+    Virtual,    // pages streamed from disk, only the ones sampled lately are in memory
+};
+
+class VirtualTexture;
+
+enum class TextureFilter
+{
+    Nearest,    // nearest texel of level 0, no mips
+    NearestMip, // nearest texel of the closest mip level
+    Bilinear,   // 2x2 texels of the closest mip level, blended with 8 bit weights
+    Trilinear,  // bilinear in the two closest mip levels, blended by the fractional lod
+};
+
+struct MipLevel
+{
+    int width;
+    int height;
+    int blocks_per_row; // Blocked4x4 and Bc1 only
+    int morton_bits;    // Morton only, bits of the narrower padded dimension
+    uint32_t id;        // unique per level, tags its blocks in the decoded block cache
+    std::vector<Color> texels;
+    std::vector<uint64_t> blocks; // Bc1 only, texels is empty then
+    VirtualTexture* virtual_texture = nullptr; // Virtual only, owns the level's pages
+    int virtual_level = 0;
+};
+
+// The part of a texture a draw's uvs map onto, uvs repeat inside it. Worked out once per draw so
+// sampling only adds one multiply-add to the wrapped uv.
+struct TextureRegion
+{
+    glm::vec2 scale{1.0f, 1.0f};
+    glm::vec2 offset{0.0f, 0.0f};
+};
+
+// equally sized cells in rows and columns, in texels. Cells are pitch apart so gutters can separate them
+struct AtlasGrid
+{
+    glm::ivec2 origin;
+    glm::ivec2 pitch;
+    glm::ivec2 cell_size;
+    glm::ivec2 cell_count;
+};
+
+class MyTexture
+{
+public:
+    MyTexture() = default;
+    // copies the image's pixels, it can be unloaded afterwards
+    explicit MyTexture(const Image& image, const TextureLayout layout = TextureLayout::Linear);
+
+    bool is_ready() const { return !m_levels.empty(); }
+    TextureLayout layout() const { return m_layout; }
+    VirtualTexture* virtual_texture() const { return m_virtual_texture.get(); }
+    int width() const { return is_ready() ? m_levels[0].width : 0; }
+    int height() const { return is_ready() ? m_levels[0].height : 0; }
+    int level_count() const { return (int)m_levels.size(); }
+    const MipLevel& level(const int index) const { return m_levels[index]; }
+    size_t memory_size() const;
+
+private:
+    std::vector<MipLevel> m_levels;
+    TextureLayout m_layout = TextureLayout::Linear;
+    // shared by copies, their levels point at it
+    std::shared_ptr<VirtualTexture> m_virtual_texture;
+};
+
+extern TextureFilter g_texture_filter;
+// layout of textures loaded from now on
+extern TextureLayout g_texture_layout;
+
+const char* GetTextureFilterName(const TextureFilter filter);
+int GetTexelsPerSample(const TextureFilter filter);
+const char* GetTextureLayoutName(const TextureLayout layout);
+// texels is a rectangle in texels of level 0
+TextureRegion GetTextureRegion(const MyTexture& texture, const Rectangle& texels);
+// cells outside the grid clamp to its edges
+TextureRegion GetAtlasCellRegion(const MyTexture& texture, const AtlasGrid& grid, const int column, const int row);
+
+// moves the low 16 bits to the even bit positions
+inline uint32_t SpreadBits(uint32_t value)
+{
+    value &= 0xffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+struct DecodedBlock
+{
+    uint64_t tag; // level id and block index, 0 is never used
+    Color texels[16];
+};
+
+constexpr int k_decoded_block_cache_size = 256;
+
+// direct mapped, a 16x16 block window of a level maps to distinct entries
+struct DecodedBlockCache
+{
+    DecodedBlock blocks[k_decoded_block_cache_size];
+};
+
+inline thread_local DecodedBlockCache t_decoded_block_cache;
+
+Color FetchVirtualTexel(const MipLevel& level, const int x, const int y);
+void DecodeBc1Block(const MipLevel& level, const int block_x, const int block_y, const uint64_t tag, DecodedBlock& decoded);
+
+inline Color FetchBc1Texel(const MipLevel& level, const int x, const int y)
+{
+    const int block_x = x >> 2;
+    const int block_y = y >> 2;
+    const uint64_t tag = (uint64_t)level.id << 32 | (uint32_t)(block_y * level.blocks_per_row + block_x);
+    DecodedBlock& decoded = t_decoded_block_cache.blocks[((block_x & 15) | (block_y & 15) << 4) ^ ((level.id * 37) & 255)];
+    if(decoded.tag != tag)
+    {
+        DecodeBc1Block(level, block_x, block_y, tag, decoded);
+    }
+
+    return decoded.texels[(y & 3) * 4 + (x & 3)];
+}
+
+template<TextureLayout layout>
+inline size_t GetTexelIndex(const MipLevel& level, const int x, const int y)
+{
+    // Bc1 blocks are in the same order, this is the texel's index as if they were decoded
+    if constexpr(layout == TextureLayout::Blocked4x4 || layout == TextureLayout::Bc1)
+    {
+        const size_t block = (size_t)(y >> 2) * level.blocks_per_row + (x >> 2);
+        return block * 16 + (y & 3) * 4 + (x & 3);
+    }
+    else if constexpr(layout == TextureLayout::Morton)
+    {
+        // x and y interleave up to the narrower dimension, the rest of the wider one goes on top
+        const uint32_t mask = (1u << level.morton_bits) - 1;
+        const uint32_t interleaved = SpreadBits(x & mask) | SpreadBits(y & mask) << 1;
+        const uint32_t high = (uint32_t)(x | y) >> level.morton_bits;
+        return (size_t)high << (2 * level.morton_bits) | interleaved;
+    }
+    else
+    {
+        return (size_t)y * level.width + x;
+    }
+}
+
+template<TextureLayout layout>
+inline Color FetchTexel(const MipLevel& level, const int x, const int y)
+{
+    if constexpr(layout == TextureLayout::Bc1)
+    {
+        return FetchBc1Texel(level, x, y);
+    }
+    else if constexpr(layout == TextureLayout::Virtual)
+    {
+        return FetchVirtualTexel(level, x, y);
+    }
+    else
+    {
+        return level.texels[GetTexelIndex<layout>(level, x, y)];
+    }
+}
+
+inline int WrapTexelCoordinate(const int coordinate, const int size)
+{
+    const int wrapped = coordinate % size;
+    return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+// uv in 0 to 1
+template<TextureLayout layout>
+inline glm::vec4 SampleNearest(const MipLevel& level, const glm::vec2 uv)
+{
+    const int u = std::min((int)glm::floor(uv.x * level.width), level.width - 1);
+    const int v = std::min((int)glm::floor(uv.y * level.height), level.height - 1);
+    return NormalizeColor(FetchTexel<layout>(level, u, v));
+}
+
+// the 2x2 texels a bilinear sample blends and how far it is towards the right and bottom ones, out of 256
+struct BilinearTaps
+{
+    const Color* texels;
+    size_t top_left;
+    size_t top_right;
+    size_t bottom_left;
+    size_t bottom_right;
+    int weight_x;
+    int weight_y;
+};
+
+// uv in 0 to 1, the neighbours wrap around the edges. Layouts that can't be addressed in place copy
+// the four texels to gathered and the taps point there
+template<TextureLayout layout>
+inline BilinearTaps GetBilinearTaps(const MipLevel& level, const glm::vec2 uv, Color* gathered)
+{
+    const glm::vec2 texcoords = uv * glm::vec2(level.width, level.height) - 0.5f;
+    const glm::vec2 floored = glm::floor(texcoords);
+    const glm::vec2 weight = (texcoords - floored) * 256.0f + 0.5f;
+    const int u0 = WrapTexelCoordinate((int)floored.x, level.width);
+    const int v0 = WrapTexelCoordinate((int)floored.y, level.height);
+    const int u1 = u0 + 1 == level.width ? 0 : u0 + 1;
+    const int v1 = v0 + 1 == level.height ? 0 : v0 + 1;
+    if constexpr(layout == TextureLayout::Bc1 || layout == TextureLayout::Virtual)
+    {
+        gathered[0] = FetchTexel<layout>(level, u0, v0);
+        gathered[1] = FetchTexel<layout>(level, u1, v0);
+        gathered[2] = FetchTexel<layout>(level, u0, v1);
+        gathered[3] = FetchTexel<layout>(level, u1, v1);
+        return {gathered, 0, 1, 2, 3, (int)weight.x, (int)weight.y};
+    }
+
+    return {
+        level.texels.data(),
+        GetTexelIndex<layout>(level, u0, v0),
+        GetTexelIndex<layout>(level, u1, v0),
+        GetTexelIndex<layout>(level, u0, v1),
+        GetTexelIndex<layout>(level, u1, v1),
+        (int)weight.x,
+        (int)weight.y,
+    };
+}
+
+// the same rounding as the SIMD kernel, both give the exact same colors
+inline Color LerpColor(const Color a, const Color b, const int weight)
+{
+    const auto Lerp = [&](unsigned char Color::* channel){
+        return (unsigned char)((a.*channel * (256 - weight) + b.*channel * weight) >> 8);
+    };
+
+    return {Lerp(&Color::r), Lerp(&Color::g), Lerp(&Color::b), Lerp(&Color::a)};
+}
+
+inline Color SampleBilinearTaps(const BilinearTaps& taps)
+{
+    const Color top = LerpColor(taps.texels[taps.top_left], taps.texels[taps.top_right], taps.weight_x);
+    const Color bottom = LerpColor(taps.texels[taps.bottom_left], taps.texels[taps.bottom_right], taps.weight_x);
+    return LerpColor(top, bottom, taps.weight_y);
+}
+
+// uv in 0 to 1, the neighbours wrap around the edges
+template<TextureLayout layout>
+inline glm::vec4 SampleBilinear(const MipLevel& level, const glm::vec2 uv)
+{
+    const glm::vec2 texcoords = uv * glm::vec2(level.width, level.height) - 0.5f;
+    const glm::vec2 floored = glm::floor(texcoords);
+    const glm::vec2 weight = texcoords - floored;
+    const int u0 = WrapTexelCoordinate((int)floored.x, level.width);
+    const int v0 = WrapTexelCoordinate((int)floored.y, level.height);
+    const int u1 = u0 + 1 == level.width ? 0 : u0 + 1;
+    const int v1 = v0 + 1 == level.height ? 0 : v0 + 1;
+    const glm::vec4 top = glm::mix(
+        NormalizeColor(FetchTexel<layout>(level, u0, v0)),
+        NormalizeColor(FetchTexel<layout>(level, u1, v0)), weight.x);
+    const glm::vec4 bottom = glm::mix(
+        NormalizeColor(FetchTexel<layout>(level, u0, v1)),
+        NormalizeColor(FetchTexel<layout>(level, u1, v1)), weight.x);
+    return glm::mix(top, bottom, weight.y);
+}
+
+// lod is log2 of the texels covered per pixel, anything below 0 magnifies level 0. Bilinear taps at the
+// edges of a region reach into its neighbours, gutters in the atlas keep that from showing
+template<TextureLayout layout>
+inline glm::vec4 SampleTexture(const MyTexture& texture, const glm::vec2 uv, const float lod, const TextureFilter filter, const TextureRegion& region)
+{
+    const glm::vec2 wrapped_uv = glm::fract(uv) * region.scale + region.offset;
+    const int last_level = texture.level_count() - 1;
+    switch(filter)
+    {
+        case TextureFilter::NearestMip:
+        {
+            const int level = std::clamp((int)glm::round(lod), 0, last_level);
+            return SampleNearest<layout>(texture.level(level), wrapped_uv);
+        }
+        case TextureFilter::Bilinear:
+        {
+            const int level = std::clamp((int)glm::round(lod), 0, last_level);
+            Color gathered[4];
+            return NormalizeColor(SampleBilinearTaps(GetBilinearTaps<layout>(texture.level(level), wrapped_uv, gathered)));
+        }
+        case TextureFilter::Trilinear:
+        {
+            const float clamped_lod = std::clamp(lod, 0.0f, (float)last_level);
+            const int level = (int)clamped_lod;
+            const float blend = clamped_lod - level;
+            const glm::vec4 near_color = SampleBilinear<layout>(texture.level(level), wrapped_uv);
+            if(blend == 0.0f)
+            {
+                return near_color;
+            }
+
+            return glm::mix(near_color, SampleBilinear<layout>(texture.level(level + 1), wrapped_uv), blend);
+        }
+        default:
+            return SampleNearest<layout>(texture.level(0), wrapped_uv);
+    }
+}
+
+inline glm::vec4 SampleTexture(const MyTexture& texture, const glm::vec2 uv, const float lod, const TextureFilter filter, const TextureRegion& region = {})
+{
+    switch(texture.layout())
+    {
+        case TextureLayout::Blocked4x4: return SampleTexture<TextureLayout::Blocked4x4>(texture, uv, lod, filter, region);
+        case TextureLayout::Morton: return SampleTexture<TextureLayout::Morton>(texture, uv, lod, filter, region);
+        case TextureLayout::Bc1: return SampleTexture<TextureLayout::Bc1>(texture, uv, lod, filter, region);
+        case TextureLayout::Virtual: return SampleTexture<TextureLayout::Virtual>(texture, uv, lod, filter, region);
+        default: return SampleTexture<TextureLayout::Linear>(texture, uv, lod, filter, region);
+    }
+}
+
+// TextureFilter::Bilinear for a run of pixels, 4 at a time with SSE2 when the compiler targets it
+void SampleBilinearBatch(const MyTexture& texture, const glm::vec2* uvs, const float* lods, const int count, const TextureRegion& region, Color* colors);
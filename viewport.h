@@ -6,8 +6,12 @@
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/gtc/epsilon.hpp"
 
+#include "framebuffer.h"
 #include "raylib.h"
 
+#include <cstdint>
+#include <vector>
+
 typedef float ftype;
 
 struct MyCamera
@@ -33,6 +37,11 @@ struct Viewport
     Texture2D z_tex2d;
     Image color_buffer;
     Texture2D color_tex2d;
+    // what the rasterizer writes into, resolved into z_buffer and color_buffer after every frame
+    Framebuffer framebuffer;
+    // fragments per pixel, only counted while the overdraw view is on
+    std::vector<uint16_t> fragment_counts;
+    std::vector<uint16_t> depth_passed_counts;
     ftype last_fov;
     ftype last_near_z;
     ftype last_far_z;
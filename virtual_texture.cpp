@@ -0,0 +1,286 @@
+#include "virtual_texture.h"
+
+#include "counters.h"
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+int g_virtual_page_budget = 256;
+std::atomic<int> g_next_page_file_index{0};
+
+int GetVirtualPageBudget(const glm::ivec2 screen_size)
+{
+    const int screen_pages = (screen_size.x * screen_size.y + k_virtual_page_texel_count - 1) / k_virtual_page_texel_count;
+    return std::max(64, screen_pages * 2);
+}
+
+Color FetchVirtualTexel(const MipLevel& level, const int x, const int y)
+{
+    return level.virtual_texture->Fetch(level.virtual_level, x, y);
+}
+
+std::unique_ptr<VirtualTexture> VirtualTexture::Create(const std::vector<MipLevel>& levels, const int page_budget)
+{
+    std::unique_ptr<VirtualTexture> texture{new VirtualTexture()};
+    int page_count = 0;
+    int pinned_count = 0;
+    for(const MipLevel& level : levels)
+    {
+        const Level virtual_level{
+            level.width,
+            level.height,
+            (level.width + k_virtual_page_size - 1) / k_virtual_page_size,
+            (level.height + k_virtual_page_size - 1) / k_virtual_page_size,
+            page_count,
+        };
+
+        texture->m_levels.push_back(virtual_level);
+        page_count += virtual_level.pages_x * virtual_level.pages_y;
+        pinned_count += virtual_level.pages_x * virtual_level.pages_y == 1 ? 1 : 0;
+    }
+
+    const std::string file_name = "demo3d_pages_" + std::to_string(g_next_page_file_index.fetch_add(1)) + ".bin";
+    texture->m_page_file_path = std::filesystem::temp_directory_path() / file_name;
+    std::FILE* file = std::fopen(texture->m_page_file_path.string().c_str(), "w+b");
+    if(!file)
+    {
+        LogError("Failed to create the page file %s", texture->m_page_file_path.string().c_str());
+        return nullptr;
+    }
+
+    texture->m_page_file = file;
+    texture->m_page_slots.assign(page_count, -1);
+    texture->m_page_wanted.assign(page_count, 0);
+    texture->m_page_pending.assign(page_count, false);
+    const int slot_count = pinned_count + std::max(1, page_budget);
+    texture->m_slot_pages.assign(slot_count, -1);
+    texture->m_slot_last_used.assign(slot_count, -1);
+    texture->m_slot_pinned.assign(slot_count, false);
+    texture->m_slot_texels.resize((size_t)slot_count * k_virtual_page_texel_count);
+
+    // pages are written level after level, row after row, each one k_virtual_page_size texels square.
+    // Pages over the edge of a level repeat its last row and column
+    std::vector<Color> page_texels(k_virtual_page_texel_count);
+    for(size_t level_index = 0; level_index < levels.size(); ++level_index)
+    {
+        const MipLevel& level = levels[level_index];
+        const Level& virtual_level = texture->m_levels[level_index];
+        for(int page_y = 0; page_y < virtual_level.pages_y; ++page_y)
+        {
+            for(int page_x = 0; page_x < virtual_level.pages_x; ++page_x)
+            {
+                for(int y = 0; y < k_virtual_page_size; ++y)
+                {
+                    const int level_y = std::min(page_y * k_virtual_page_size + y, level.height - 1);
+                    for(int x = 0; x < k_virtual_page_size; ++x)
+                    {
+                        const int level_x = std::min(page_x * k_virtual_page_size + x, level.width - 1);
+                        page_texels[y * k_virtual_page_size + x] = level.texels[(size_t)level_y * level.width + level_x];
+                    }
+                }
+
+                if(std::fwrite(page_texels.data(), sizeof(Color), page_texels.size(), file) != page_texels.size())
+                {
+                    LogError("Failed to write the page file %s", texture->m_page_file_path.string().c_str());
+                    return nullptr;
+                }
+
+                if(virtual_level.pages_x * virtual_level.pages_y == 1)
+                {
+                    texture->InstallPage(virtual_level.first_page, page_texels.data(), true);
+                }
+            }
+        }
+    }
+
+    std::fflush(file);
+    texture->m_loader = std::thread(&VirtualTexture::RunLoader, texture.get());
+    Log("Virtual texture: %d pages of %dx%d texels, %d resident at most, %d pinned",
+        page_count, k_virtual_page_size, k_virtual_page_size, slot_count, pinned_count);
+    return texture;
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    if(m_loader.joinable())
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stop_requested = true;
+        }
+
+        m_loader_wake.notify_one();
+        m_loader.join();
+    }
+
+    if(m_page_file)
+    {
+        std::fclose(m_page_file);
+        std::error_code error;
+        std::filesystem::remove(m_page_file_path, error);
+    }
+}
+
+Color VirtualTexture::Fetch(int level, int x, int y)
+{
+    const Level* virtual_level = &m_levels[level];
+    int page = virtual_level->first_page + (y / k_virtual_page_size) * virtual_level->pages_x + x / k_virtual_page_size;
+    m_page_wanted[page] = 1;
+
+    // the coarsest levels are pinned, the walk always ends on a resident page
+    while(m_page_slots[page] < 0)
+    {
+        ++level;
+        virtual_level = &m_levels[level];
+        x = std::min(x >> 1, virtual_level->width - 1);
+        y = std::min(y >> 1, virtual_level->height - 1);
+        page = virtual_level->first_page + (y / k_virtual_page_size) * virtual_level->pages_x + x / k_virtual_page_size;
+    }
+
+    const size_t texel = (size_t)m_page_slots[page] * k_virtual_page_texel_count + (y % k_virtual_page_size) * k_virtual_page_size + x % k_virtual_page_size;
+    return m_slot_texels[texel];
+}
+
+void VirtualTexture::Update(const bool wait_for_pages)
+{
+    ++m_frame;
+    std::vector<int> requests;
+    for(int page = 0; page < (int)m_page_wanted.size(); ++page)
+    {
+        if(!m_page_wanted[page])
+        {
+            continue;
+        }
+
+        m_page_wanted[page] = 0;
+        const int slot = m_page_slots[page];
+        if(slot >= 0)
+        {
+            m_slot_last_used[slot] = m_frame;
+        }
+        else if(!m_page_pending[page])
+        {
+            m_page_pending[page] = true;
+            requests.push_back(page);
+        }
+    }
+
+    std::vector<LoadedPage> loaded;
+    {
+        std::unique_lock lock{m_mutex};
+        m_requests.insert(m_requests.end(), requests.begin(), requests.end());
+        if(wait_for_pages)
+        {
+            m_loader_wake.notify_one();
+            m_page_loaded.wait(lock, [&]{ return m_requests.empty() && m_in_flight_count == 0; });
+        }
+
+        loaded.swap(m_loaded);
+    }
+
+    if(!requests.empty())
+    {
+        m_loader_wake.notify_one();
+    }
+
+    COUNTER_ADD(Counter::VirtualPagesLoaded, (int64_t)loaded.size());
+    for(const LoadedPage& page : loaded)
+    {
+        m_page_pending[page.page] = false;
+        if(!page.texels.empty())
+        {
+            InstallPage(page.page, page.texels.data(), false);
+        }
+    }
+}
+
+size_t VirtualTexture::memory_size() const
+{
+    return m_slot_texels.size() * sizeof(Color) + m_page_slots.size() * sizeof(int) + m_page_wanted.size();
+}
+
+void VirtualTexture::InstallPage(const int page, const Color* texels, const bool is_pinned)
+{
+    const int slot = is_pinned ? (int)std::distance(m_slot_pages.begin(), std::find(m_slot_pages.begin(), m_slot_pages.end(), -1)) : FindEvictableSlot();
+    if(slot < 0 || slot >= (int)m_slot_pages.size())
+    {
+        // every slot held a page the last frame wanted, the page gets requested again while it is still wanted
+        return;
+    }
+
+    if(m_slot_pages[slot] >= 0)
+    {
+        m_page_slots[m_slot_pages[slot]] = -1;
+        --m_resident_page_count;
+    }
+
+    std::copy(texels, texels + k_virtual_page_texel_count, m_slot_texels.begin() + (size_t)slot * k_virtual_page_texel_count);
+    m_slot_pages[slot] = page;
+    m_slot_last_used[slot] = m_frame;
+    m_slot_pinned[slot] = is_pinned;
+    m_page_slots[page] = slot;
+    ++m_resident_page_count;
+}
+
+int VirtualTexture::FindEvictableSlot() const
+{
+    // a free slot or else the least recently used one, as long as the frame that just ended didn't use it
+    int best_slot = -1;
+    for(int slot = 0; slot < (int)m_slot_pages.size(); ++slot)
+    {
+        if(m_slot_pinned[slot])
+        {
+            continue;
+        }
+
+        if(m_slot_pages[slot] < 0)
+        {
+            return slot;
+        }
+
+        if(m_slot_last_used[slot] < m_frame && (best_slot < 0 || m_slot_last_used[slot] < m_slot_last_used[best_slot]))
+        {
+            best_slot = slot;
+        }
+    }
+
+    return best_slot;
+}
+
+void VirtualTexture::RunLoader()
+{
+    std::vector<Color> texels(k_virtual_page_texel_count);
+    std::unique_lock lock{m_mutex};
+    while(true)
+    {
+        m_loader_wake.wait(lock, [&]{ return m_stop_requested || !m_requests.empty(); });
+        if(m_stop_requested)
+        {
+            return;
+        }
+
+        const int page = m_requests.front();
+        m_requests.pop_front();
+        ++m_in_flight_count;
+        lock.unlock();
+
+        // only this thread reads the file once it is written
+        const long offset = (long)((size_t)page * k_virtual_page_texel_count * sizeof(Color));
+        const bool is_read = std::fseek(m_page_file, offset, SEEK_SET) == 0
+            && std::fread(texels.data(), sizeof(Color), texels.size(), m_page_file) == texels.size();
+
+        lock.lock();
+        --m_in_flight_count;
+        if(!is_read)
+        {
+            LogError("Failed to read page %d of %s", page, m_page_file_path.string().c_str());
+        }
+
+        // a page without texels only stops being pending, it gets requested again while it is wanted
+        m_loaded.push_back({page, is_read ? texels : std::vector<Color>{}});
+
+        m_page_loaded.notify_all();
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "texture.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sparse virtual texturing. The mip chain lives in a page file on disk, split into square pages of
+// k_virtual_page_size texels, and only a bounded number of pages is resident. Fetches mark the pages
+// they wanted in a feedback table, Update after the frame queues the missing ones for a loader
+// thread, installs the ones that finished and evicts the least recently used. Until a page arrives
+// fetches fall back to the closest coarser level that is resident, the levels that fit in one page
+// are always resident so every fetch finds something. The page budget follows the screen size, so
+// memory use depends on the resolution instead of on the texture size.
+
+constexpr int k_virtual_page_size = 64;
+constexpr int k_virtual_page_texel_count = k_virtual_page_size * k_virtual_page_size;
+
+// pages resident at once for textures created from now on
+extern int g_virtual_page_budget;
+
+// enough pages to cover every pixel of the screen about twice, pages are never filled edge to edge
+int GetVirtualPageBudget(const glm::ivec2 screen_size);
+
+class VirtualTexture
+{
+public:
+    // writes every level to a temporary page file, returns nullptr when that fails
+    static std::unique_ptr<VirtualTexture> Create(const std::vector<MipLevel>& levels, const int page_budget);
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+    ~VirtualTexture();
+
+    Color Fetch(int level, int x, int y);
+    // once per frame after rendering. Waiting blocks until every page requested so far is resident,
+    // headless runs use it to render the same frames on every run
+    void Update(const bool wait_for_pages);
+
+    int resident_page_count() const { return m_resident_page_count; }
+    int page_capacity() const { return (int)m_slot_pages.size(); }
+    size_t memory_size() const;
+
+private:
+    struct Level
+    {
+        int width;
+        int height;
+        int pages_x;
+        int pages_y;
+        int first_page;
+    };
+
+    struct LoadedPage
+    {
+        int page;
+        std::vector<Color> texels;
+    };
+
+    VirtualTexture() = default;
+    void InstallPage(const int page, const Color* texels, const bool is_pinned);
+    int FindEvictableSlot() const;
+    void RunLoader();
+
+    std::vector<Level> m_levels;
+    std::vector<int> m_page_slots;           // per page, -1 while not resident
+    std::vector<unsigned char> m_page_wanted; // feedback, per page, cleared every Update
+    std::vector<bool> m_page_pending;        // queued or being loaded
+    std::vector<int> m_slot_pages;           // per slot, -1 while free
+    std::vector<int64_t> m_slot_last_used;   // frame, pinned slots never get evicted
+    std::vector<bool> m_slot_pinned;
+    std::vector<Color> m_slot_texels;
+    int m_resident_page_count = 0;
+    int64_t m_frame = 0;
+
+    std::filesystem::path m_page_file_path;
+    std::FILE* m_page_file = nullptr;
+    std::thread m_loader;
+    std::mutex m_mutex;
+    std::condition_variable m_loader_wake;
+    std::condition_variable m_page_loaded;
+    std::deque<int> m_requests;
+    std::vector<LoadedPage> m_loaded;
+    int m_in_flight_count = 0;
+    bool m_stop_requested = false;
+};